@@ -0,0 +1,150 @@
+#pragma once
+
+#include "unordered_map.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Group-by accumulator for `map[key] = combine(map[key], delta)` issued from
+// many threads. Every thread folds into a private shard and only takes the
+// shared table's lock to spill a whole shard at once, so the per-call cost is
+// one uncontended lock plus one probe of a small local table.
+template<typename Key
+        , typename Value
+        , typename Combine = std::plus<Value>
+        , typename Hash = std::hash<Key>
+        , typename Equal = std::equal_to<Key>
+        , typename Alloc = std::allocator<std::pair<const Key, Value>>>
+class AggregatingUnorderedMap {
+public:
+    using Map = UnorderedMap<Key, Value, Hash, Equal, Alloc>;
+private:
+    // The shard mutex is only contended while merge_all() drains it.
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        Map local;
+        Shard(const Hash& hash, const Equal& equal, const Alloc& alloc): local(0, hash, equal, alloc) {}
+    };
+
+    inline static std::atomic<uint64_t> next_instance_id{1};
+    const uint64_t instance_id = next_instance_id.fetch_add(1, std::memory_order_relaxed);
+    [[no_unique_address]] Combine combine;
+    [[no_unique_address]] Hash hash;
+    [[no_unique_address]] Equal equal;
+    size_t spill_threshold;
+    std::mutex merged_mutex;
+    Map merged;
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<Shard>> shards;
+    UnorderedMap<std::thread::id, Shard*> shard_of_thread;
+
+    Shard& local_shard();
+    void fold(Map& target, const Key& key, Value&& delta);
+    void spill(Shard& shard);
+public:
+    explicit AggregatingUnorderedMap(size_t spill_threshold = size_t(1) << 12
+            , const Combine& combine = Combine()
+            , const Hash& hash = Hash()
+            , const Equal& equal = Equal()
+            , const Alloc& alloc = Alloc());
+    AggregatingUnorderedMap(const AggregatingUnorderedMap& other) = delete;
+    AggregatingUnorderedMap& operator=(const AggregatingUnorderedMap& other) = delete;
+    void upsert(const Key& key, const Value& delta);
+    const Map& merge_all();
+    void clear();
+};
+
+template<typename Key, typename Value, typename Combine, typename Hash, typename Equal, typename Alloc>
+AggregatingUnorderedMap<Key, Value, Combine, Hash, Equal, Alloc>::AggregatingUnorderedMap(size_t spill_threshold
+        , const Combine& combine
+        , const Hash& hash
+        , const Equal& equal
+        , const Alloc& alloc)
+        : combine(combine)
+        , hash(hash)
+        , equal(equal)
+        , spill_threshold(spill_threshold == 0 ? 1 : spill_threshold)
+        , merged(0, hash, equal, alloc) {}
+
+// Each thread caches only the shard it used last, keyed by instance id. Ids
+// are never reused, so a cache entry left behind by a destroyed aggregator is
+// never dereferenced; everything else lives in the aggregator itself.
+template<typename Key, typename Value, typename Combine, typename Hash, typename Equal, typename Alloc>
+typename AggregatingUnorderedMap<Key, Value, Combine, Hash, Equal, Alloc>::Shard&
+AggregatingUnorderedMap<Key, Value, Combine, Hash, Equal, Alloc>::local_shard() {
+    thread_local uint64_t last_instance_id = 0;
+    thread_local Shard* last_shard = nullptr;
+    if (last_instance_id == instance_id) {
+        return *last_shard;
+    }
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto it = shard_of_thread.find(std::this_thread::get_id());
+    if (it == shard_of_thread.end()) {
+        shards.push_back(std::make_unique<Shard>(hash, equal, merged.get_allocator()));
+        it = shard_of_thread.insert({std::this_thread::get_id(), shards.back().get()}).first;
+    }
+    last_instance_id = instance_id;
+    last_shard = it->second;
+    return *last_shard;
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash, typename Equal, typename Alloc>
+void AggregatingUnorderedMap<Key, Value, Combine, Hash, Equal, Alloc>::fold(
+        Map& target, const Key& key, Value&& delta) {
+    auto it = target.find(key);
+    if (it == target.end()) {
+        target.insert({key, std::move(delta)});
+    } else {
+        it->second = combine(std::move(it->second), std::move(delta));
+    }
+}
+
+// Caller holds shard.mutex.
+template<typename Key, typename Value, typename Combine, typename Hash, typename Equal, typename Alloc>
+void AggregatingUnorderedMap<Key, Value, Combine, Hash, Equal, Alloc>::spill(Shard& shard) {
+    std::lock_guard<std::mutex> lock(merged_mutex);
+    for (auto& element : shard.local) {
+        fold(merged, element.first, std::move(element.second));
+    }
+    shard.local.clear();
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash, typename Equal, typename Alloc>
+void AggregatingUnorderedMap<Key, Value, Combine, Hash, Equal, Alloc>::upsert(const Key& key, const Value& delta) {
+    Shard& shard = local_shard();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    fold(shard.local, key, Value(delta));
+    if (shard.local.size() >= spill_threshold) {
+        spill(shard);
+    }
+}
+
+// The returned table is complete for every upsert that finished before the
+// call; it must not be read while other threads keep upserting.
+template<typename Key, typename Value, typename Combine, typename Hash, typename Equal, typename Alloc>
+const typename AggregatingUnorderedMap<Key, Value, Combine, Hash, Equal, Alloc>::Map&
+AggregatingUnorderedMap<Key, Value, Combine, Hash, Equal, Alloc>::merge_all() {
+    std::lock_guard<std::mutex> registry_lock(registry_mutex);
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        spill(*shard);
+    }
+    return merged;
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash, typename Equal, typename Alloc>
+void AggregatingUnorderedMap<Key, Value, Combine, Hash, Equal, Alloc>::clear() {
+    std::lock_guard<std::mutex> registry_lock(registry_mutex);
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->local.clear();
+    }
+    std::lock_guard<std::mutex> lock(merged_mutex);
+    merged.clear();
+}
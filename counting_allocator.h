@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+struct AllocationCounters {
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> deallocations{0};
+    std::atomic<size_t> live_bytes{0};
+    std::atomic<size_t> peak_bytes{0};
+
+    void record_allocation(size_t bytes) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        size_t live = live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t peak = peak_bytes.load(std::memory_order_relaxed);
+        while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    }
+    void record_deallocation(size_t bytes) {
+        deallocations.fetch_add(1, std::memory_order_relaxed);
+        live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    size_t live_allocations() const noexcept {
+        return allocations.load(std::memory_order_relaxed) - deallocations.load(std::memory_order_relaxed);
+    }
+};
+
+// Shared by a CountingAllocator and every rebound copy of it. Besides the
+// totals, each allocated type gets its own counters, so a container's nodes,
+// bucket array and side tables show up separately.
+class AllocationStats {
+public:
+    static constexpr size_t max_types = 16;
+    struct TypeCounters {
+        const std::type_info* type;
+        size_t element_size;
+        const AllocationCounters* counters;
+    };
+
+    AllocationCounters total;
+
+    AllocationCounters& counters_for(const std::type_info& type, size_t element_size);
+    // Types in first-allocation order; only types that allocated are listed.
+    std::vector<TypeCounters> by_type() const;
+private:
+    std::atomic<const std::type_info*> types[max_types] = {};
+    std::atomic<size_t> element_sizes[max_types] = {};
+    AllocationCounters counters[max_types];
+    AllocationCounters overflow;
+};
+
+inline AllocationCounters& AllocationStats::counters_for(const std::type_info& type, size_t element_size) {
+    for (size_t slot = 0; slot < max_types; ++slot) {
+        const std::type_info* claimed = types[slot].load(std::memory_order_acquire);
+        if (claimed == nullptr) {
+            if (types[slot].compare_exchange_strong(claimed, &type, std::memory_order_acq_rel)) {
+                element_sizes[slot].store(element_size, std::memory_order_relaxed);
+                return counters[slot];
+            }
+        }
+        if (*claimed == type) {
+            return counters[slot];
+        }
+    }
+    return overflow;
+}
+
+inline std::vector<AllocationStats::TypeCounters> AllocationStats::by_type() const {
+    std::vector<TypeCounters> result;
+    for (size_t slot = 0; slot < max_types; ++slot) {
+        if (const std::type_info* type = types[slot].load(std::memory_order_acquire)) {
+            result.push_back(TypeCounters{type, element_sizes[slot].load(std::memory_order_relaxed), &counters[slot]});
+        }
+    }
+    return result;
+}
+
+// Forwards to Inner and counts every allocation in a shared AllocationStats.
+template<typename T, typename Inner = std::allocator<T>>
+class CountingAllocator {
+    template<typename U, typename OtherInner>
+    friend class CountingAllocator;
+    using InnerTraits = std::allocator_traits<Inner>;
+    [[no_unique_address]] Inner inner;
+    std::shared_ptr<AllocationStats> stats;
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = typename InnerTraits::propagate_on_container_copy_assignment;
+    using propagate_on_container_move_assignment = typename InnerTraits::propagate_on_container_move_assignment;
+    using propagate_on_container_swap = typename InnerTraits::propagate_on_container_swap;
+    using is_always_equal = std::false_type;
+    template<typename U>
+    struct rebind {
+        using other = CountingAllocator<U, typename InnerTraits::template rebind_alloc<U>>;
+    };
+
+    explicit CountingAllocator(const Inner& inner = Inner())
+            : inner(inner), stats(std::make_shared<AllocationStats>()) {}
+    explicit CountingAllocator(std::shared_ptr<AllocationStats> stats, const Inner& inner = Inner())
+            : inner(inner), stats(std::move(stats)) {}
+    template<typename U, typename OtherInner>
+    CountingAllocator(const CountingAllocator<U, OtherInner>& other): inner(other.inner), stats(other.stats) {}
+
+    T* allocate(size_t count) {
+        T* pointer = InnerTraits::allocate(inner, count);
+        record_allocation(count);
+        return pointer;
+    }
+    T* allocate(size_t count, const void* hint) {
+        T* pointer = InnerTraits::allocate(inner, count, hint);
+        record_allocation(count);
+        return pointer;
+    }
+    void deallocate(T* pointer, size_t count) {
+        stats->total.record_deallocation(count * sizeof(T));
+        stats->counters_for(typeid(T), sizeof(T)).record_deallocation(count * sizeof(T));
+        InnerTraits::deallocate(inner, pointer, count);
+    }
+    const AllocationStats& statistics() const noexcept {
+        return *stats;
+    }
+    const std::shared_ptr<AllocationStats>& shared_statistics() const noexcept {
+        return stats;
+    }
+
+    template<typename U, typename OtherInner>
+    bool operator==(const CountingAllocator<U, OtherInner>& other) const noexcept {
+        return stats == other.stats && inner == other.inner;
+    }
+private:
+    void record_allocation(size_t count) {
+        stats->total.record_allocation(count * sizeof(T));
+        stats->counters_for(typeid(T), sizeof(T)).record_allocation(count * sizeof(T));
+    }
+};
@@ -0,0 +1,427 @@
+#pragma once
+
+#include "unordered_map.h"
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+struct DenseUnorderedMapLengthException : std::length_error {
+    explicit DenseUnorderedMapLengthException()
+            : std::length_error("DenseUnorderedMapLengthException") {}
+};
+
+// Elements live in one contiguous array, so iteration is a linear scan and
+// data() exports them without copying. A separate linear-probing index maps
+// keys to positions: each slot holds a 32-bit position and a 32-bit
+// fingerprint of the mixed hash, whose top bits also pick the home slot, so
+// the index grows without rehashing keys. Erase moves the last element into
+// the hole; the array is in insertion order only until the first erase.
+template<typename Key
+        , typename Value
+        , typename Hash = std::hash<Key>
+        , typename Equal = std::equal_to<Key>
+        , typename Alloc = std::allocator<std::pair<const Key, Value>>>
+class DenseUnorderedMap {
+public:
+    using NodeType = std::pair<const Key, Value>;
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = NodeType;
+    using iterator = NodeType*;
+    using const_iterator = const NodeType*;
+private:
+    using LowSecurityNodeType = std::pair<Key, Value>;
+    struct Slot {
+        uint32_t position;
+        uint32_t fingerprint;
+    };
+    using AllocTraits = std::allocator_traits<Alloc>;
+    using ElementAlloc = typename AllocTraits::template rebind_alloc<LowSecurityNodeType>;
+    using SlotAlloc = typename AllocTraits::template rebind_alloc<Slot>;
+    constexpr static uint32_t empty_slot = 0;
+    constexpr static size_t min_index_bits = 3;
+    constexpr static size_t max_index_bits = 32;
+    constexpr static size_t max_elements = UINT32_MAX - 1;
+
+    [[no_unique_address]] Hash hash;
+    [[no_unique_address]] Equal equal;
+    float max_load_factor_value = 0.875;
+    std::vector<LowSecurityNodeType, ElementAlloc> elements;
+    std::vector<Slot, SlotAlloc> slots;
+    size_t index_bits = 0;
+
+    uint32_t fingerprint_of(const Key& key) const {
+        return static_cast<uint32_t>((static_cast<uint64_t>(hash(key)) * 0x9e3779b97f4a7c15ULL) >> 32);
+    }
+    size_t home_of(uint32_t fingerprint) const {
+        return fingerprint >> (32 - index_bits);
+    }
+    size_t mask() const {
+        return slots.size() - 1;
+    }
+    size_t find_slot(const Key& key, uint32_t fingerprint) const;
+    size_t free_slot(uint32_t fingerprint) const;
+    void erase_slot(size_t slot);
+    void grow_index(size_t min_elements, float load_factor);
+    template<typename U>
+    std::pair<iterator, bool> insert_impl(U&& element);
+public:
+    explicit DenseUnorderedMap(size_t count = 0
+            , const Hash& hash = Hash()
+            , const Equal& equal = Equal()
+            , const Alloc& alloc = Alloc());
+    DenseUnorderedMap(std::initializer_list<NodeType> init
+            , size_t count = 0
+            , const Hash& hash = Hash()
+            , const Equal& equal = Equal()
+            , const Alloc& alloc = Alloc());
+    iterator begin();
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end();
+    const_iterator end() const;
+    const_iterator cend() const;
+    NodeType* data() noexcept;
+    const NodeType* data() const noexcept;
+    size_t size() const noexcept;
+    bool empty() const noexcept;
+    size_t bucket_count() const noexcept;
+    float load_factor() const noexcept;
+    float max_load_factor() const noexcept;
+    void max_load_factor(float ml);
+    void reserve(size_t count);
+    Value& at(const Key& key);
+    const Value& at(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value& operator[](Key&& key);
+    std::pair<iterator, bool> insert(const NodeType& element);
+    std::pair<iterator, bool> insert(NodeType&& element);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    bool contains(const Key& key) const;
+    size_t count(const Key& key) const;
+    iterator erase(const_iterator pos);
+    size_t erase(const Key& key);
+    void clear();
+    void swap(DenseUnorderedMap& other);
+    Alloc get_allocator() const;
+};
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::DenseUnorderedMap(size_t count
+        , const Hash& hash
+        , const Equal& equal
+        , const Alloc& alloc)
+        : hash(hash), equal(equal), elements(alloc), slots(alloc) {
+    reserve(count);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::DenseUnorderedMap(std::initializer_list<NodeType> init
+        , size_t count
+        , const Hash& hash
+        , const Equal& equal
+        , const Alloc& alloc)
+        : DenseUnorderedMap(std::max(count, init.size()), hash, equal, alloc) {
+    for (const auto& element : init) {
+        insert(element);
+    }
+}
+
+// Slot holding key, or slots.size() if there is none.
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::find_slot(const Key& key, uint32_t fingerprint) const {
+    if (slots.empty()) {
+        return 0;
+    }
+    for (size_t slot = home_of(fingerprint);; slot = (slot + 1) & mask()) {
+        const Slot& current = slots[slot];
+        if (current.position == empty_slot) {
+            return slots.size();
+        }
+        if (current.fingerprint == fingerprint && equal(elements[current.position - 1].first, key)) {
+            return slot;
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::free_slot(uint32_t fingerprint) const {
+    size_t slot = home_of(fingerprint);
+    while (slots[slot].position != empty_slot) {
+        slot = (slot + 1) & mask();
+    }
+    return slot;
+}
+
+// Backward-shift deletion: an element later in the probe run moves into the
+// hole unless its home lies between the hole and its slot, so no tombstones
+// are left behind.
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::erase_slot(size_t slot) {
+    for (size_t next = (slot + 1) & mask(); slots[next].position != empty_slot; next = (next + 1) & mask()) {
+        size_t home = home_of(slots[next].fingerprint);
+        if (((next - home) & mask()) >= ((next - slot) & mask())) {
+            slots[slot] = slots[next];
+            slot = next;
+        }
+    }
+    slots[slot] = Slot{empty_slot, 0};
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::grow_index(size_t min_elements, float load_factor) {
+    if (min_elements > max_elements) {
+        throw DenseUnorderedMapLengthException();
+    }
+    size_t new_bits = std::max(index_bits, min_index_bits);
+    while (static_cast<float>(min_elements) > static_cast<float>(size_t(1) << new_bits) * load_factor) {
+        // The home slot comes from the 32-bit fingerprint.
+        if (new_bits == max_index_bits) {
+            throw DenseUnorderedMapLengthException();
+        }
+        ++new_bits;
+    }
+    if (new_bits == index_bits) {
+        return;
+    }
+    std::vector<Slot, SlotAlloc> old_slots(size_t(1) << new_bits, Slot{empty_slot, 0}, slots.get_allocator());
+    old_slots.swap(slots);
+    index_bits = new_bits;
+    for (const Slot& slot : old_slots) {
+        if (slot.position != empty_slot) {
+            slots[free_slot(slot.fingerprint)] = slot;
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template<typename U>
+std::pair<typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator, bool>
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::insert_impl(U&& element) {
+    uint32_t fingerprint = fingerprint_of(element.first);
+    size_t slot = find_slot(element.first, fingerprint);
+    if (slot != slots.size()) {
+        return {data() + (slots[slot].position - 1), false};
+    }
+    grow_index(size() + 1, max_load_factor());
+    elements.emplace_back(std::forward<U>(element));
+    slots[free_slot(fingerprint)] = Slot{static_cast<uint32_t>(size()), fingerprint};
+    return {data() + (size() - 1), true};
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+std::pair<typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator, bool>
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::insert(const NodeType& element) {
+    return insert_impl(element);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+std::pair<typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator, bool>
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::insert(NodeType&& element) {
+    return insert_impl(std::move(*reinterpret_cast<LowSecurityNodeType*>(&element)));
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template<typename... Args>
+std::pair<typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator, bool>
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::emplace(Args&&... args) {
+    return insert_impl(LowSecurityNodeType(std::forward<Args>(args)...));
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::const_iterator
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::find(const Key& key) const {
+    size_t slot = find_slot(key, fingerprint_of(key));
+    return slot == slots.size() ? cend() : data() + (slots[slot].position - 1);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::find(const Key& key) {
+    return const_cast<iterator>(static_cast<const DenseUnorderedMap&>(*this).find(key));
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::contains(const Key& key) const {
+    return find(key) != cend();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::count(const Key& key) const {
+    return contains(key) ? 1 : 0;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+const Value& DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::at(const Key& key) const {
+    auto it = find(key);
+    if (it == cend()) {
+        throw UnorderedMapAtKeyNotFoundException();
+    }
+    return it->second;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+Value& DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::at(const Key& key) {
+    return const_cast<Value&>(static_cast<const DenseUnorderedMap&>(*this).at(key));
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+Value& DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::operator[](const Key& key) {
+    auto it = find(key);
+    if (it == end()) {
+        return insert_impl(LowSecurityNodeType(key, Value())).first->second;
+    }
+    return it->second;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+Value& DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::operator[](Key&& key) {
+    auto it = find(key);
+    if (it == end()) {
+        return insert_impl(LowSecurityNodeType(std::move(key), Value())).first->second;
+    }
+    return it->second;
+}
+
+// Returns an iterator to the same position, which now holds the element that
+// used to be last, or end() if pos was last.
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::erase(const_iterator pos) {
+    size_t position = static_cast<size_t>(pos - cbegin());
+    erase_slot(find_slot(pos->first, fingerprint_of(pos->first)));
+    size_t last = size() - 1;
+    if (position != last) {
+        LowSecurityNodeType& moving = elements[last];
+        slots[find_slot(moving.first, fingerprint_of(moving.first))].position = static_cast<uint32_t>(position + 1);
+        elements[position] = std::move(moving);
+    }
+    elements.pop_back();
+    return data() + position;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::erase(const Key& key) {
+    auto it = find(key);
+    if (it == end()) {
+        return 0;
+    }
+    erase(const_iterator(it));
+    return 1;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::clear() {
+    elements.clear();
+    std::fill(slots.begin(), slots.end(), Slot{empty_slot, 0});
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::reserve(size_t count) {
+    grow_index(count, max_load_factor());
+    elements.reserve(count);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::swap(DenseUnorderedMap& other) {
+    std::swap(hash, other.hash);
+    std::swap(equal, other.equal);
+    std::swap(max_load_factor_value, other.max_load_factor_value);
+    std::swap(elements, other.elements);
+    std::swap(slots, other.slots);
+    std::swap(index_bits, other.index_bits);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+Alloc DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::get_allocator() const {
+    return Alloc(elements.get_allocator());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::NodeType*
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::data() noexcept {
+    return reinterpret_cast<NodeType*>(elements.data());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+const typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::NodeType*
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::data() const noexcept {
+    return reinterpret_cast<const NodeType*>(elements.data());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::begin() {
+    return data();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::const_iterator
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::begin() const {
+    return data();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::const_iterator
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::cbegin() const {
+    return data();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::end() {
+    return data() + size();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::const_iterator
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::end() const {
+    return data() + size();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::const_iterator
+DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::cend() const {
+    return end();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::size() const noexcept {
+    return elements.size();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::empty() const noexcept {
+    return elements.empty();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::bucket_count() const noexcept {
+    return slots.size();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+float DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::load_factor() const noexcept {
+    return slots.empty() ? 0 : static_cast<float>(size()) / static_cast<float>(slots.size());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+float DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::max_load_factor() const noexcept {
+    return max_load_factor_value;
+}
+
+// Linear probing needs at least one empty slot, so the bound stays below 1.
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void DenseUnorderedMap<Key, Value, Hash, Equal, Alloc>::max_load_factor(float ml) {
+    ml = std::clamp(ml, 0.125f, 0.95f);
+    grow_index(size(), ml);
+    max_load_factor_value = ml;
+}
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+struct FileBackedAllocationException : std::bad_alloc {
+    const char* what() const noexcept override {
+        return "FileBackedAllocationException";
+    }
+};
+
+// Places allocations in an anonymous file in the given directory, mapped into
+// one reserved address range, so the mapping can grow without moving and cold
+// pages are written back to the file instead of exhausting RAM. Small blocks
+// are grouped into per-size-class pages; an allocation with a hint that points
+// into a page of its class lands on that page, keeping a bucket's nodes
+// together.
+class FileBackedArena {
+public:
+    static constexpr size_t page_size = 4096;
+
+    explicit FileBackedArena(const std::string& directory
+            , size_t max_bytes = size_t(1) << 40
+            , size_t growth_bytes = size_t(64) << 20);
+    FileBackedArena(const FileBackedArena&) = delete;
+    FileBackedArena& operator=(const FileBackedArena&) = delete;
+    ~FileBackedArena() {
+        munmap(base, reserved_bytes);
+        close(file);
+    }
+
+    void* allocate(size_t bytes, size_t alignment, const void* hint);
+    void deallocate(void* pointer, size_t bytes, size_t alignment);
+    void advise(int advice);
+    size_t mapped_bytes() const noexcept {
+        return mapped;
+    }
+private:
+    struct PageInfo {
+        uint16_t size_class = 0;
+        uint16_t bump = 0;
+        uint16_t free_head = 0;
+        uint16_t live = 0;
+    };
+    static constexpr size_t granularity = 16;
+    static constexpr size_t small_limit = page_size / 4;
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    int file;
+    char* base;
+    size_t reserved_bytes;
+    size_t growth;
+    size_t mapped = 0;
+    size_t used_pages = 0;
+    int current_advice = MADV_RANDOM;
+    std::mutex mutex;
+    std::vector<PageInfo> pages;
+    std::vector<size_t> open_pages = std::vector<size_t>(small_limit / granularity + 1, npos);
+    std::vector<std::vector<size_t>> partial_pages = std::vector<std::vector<size_t>>(small_limit / granularity + 1);
+    std::map<size_t, size_t> free_runs;
+
+    static size_t round_up(size_t value, size_t multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+    static size_t class_of(size_t bytes, size_t alignment) {
+        return round_up(bytes == 0 ? 1 : bytes, alignment > granularity ? alignment : granularity);
+    }
+    bool has_room(const PageInfo& page) const {
+        return page.free_head != 0 || page.bump + page.size_class <= page_size;
+    }
+    size_t take_pages(size_t count);
+    void release_pages(size_t first, size_t count);
+    void* take_slot(size_t page_index);
+};
+
+// The file never has a name unless O_TMPFILE is unavailable; then mkstemp()
+// creates a fresh one, which is unlinked at once. An existing file is never
+// opened.
+inline FileBackedArena::FileBackedArena(const std::string& directory, size_t max_bytes, size_t growth_bytes)
+        : reserved_bytes(round_up(max_bytes, page_size))
+        , growth(round_up(growth_bytes, page_size)) {
+    file = -1;
+#ifdef O_TMPFILE
+    file = open(directory.c_str(), O_TMPFILE | O_RDWR, 0600);
+#endif
+    if (file < 0) {
+        std::string name = directory + "/file_backed_arena.XXXXXX";
+        file = mkstemp(name.data());
+        if (file < 0) {
+            throw FileBackedAllocationException();
+        }
+        unlink(name.c_str());
+    }
+    void* reservation = mmap(nullptr, reserved_bytes, PROT_NONE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reservation == MAP_FAILED) {
+        close(file);
+        throw FileBackedAllocationException();
+    }
+    base = static_cast<char*>(reservation);
+}
+
+inline size_t FileBackedArena::take_pages(size_t count) {
+    for (auto it = free_runs.begin(); it != free_runs.end(); ++it) {
+        if (it->second >= count) {
+            size_t first = it->first;
+            size_t rest = it->second - count;
+            free_runs.erase(it);
+            if (rest != 0) {
+                free_runs.emplace(first + count, rest);
+            }
+            return first;
+        }
+    }
+    size_t first = used_pages;
+    size_t needed = (first + count) * page_size;
+    if (needed > mapped) {
+        size_t new_mapped = round_up(needed > mapped + growth ? needed : mapped + growth, growth);
+        if (new_mapped > reserved_bytes || ftruncate(file, static_cast<off_t>(new_mapped)) != 0) {
+            throw FileBackedAllocationException();
+        }
+        void* region = mmap(base + mapped, new_mapped - mapped, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_FIXED, file, static_cast<off_t>(mapped));
+        if (region == MAP_FAILED) {
+            throw FileBackedAllocationException();
+        }
+        madvise(region, new_mapped - mapped, current_advice);
+        mapped = new_mapped;
+    }
+    used_pages += count;
+    pages.resize(used_pages);
+    return first;
+}
+
+inline void FileBackedArena::release_pages(size_t first, size_t count) {
+    fallocate(file, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+              static_cast<off_t>(first * page_size), static_cast<off_t>(count * page_size));
+    auto next = free_runs.lower_bound(first);
+    if (next != free_runs.end() && first + count == next->first) {
+        count += next->second;
+        next = free_runs.erase(next);
+    }
+    if (next != free_runs.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == first) {
+            previous->second += count;
+            return;
+        }
+    }
+    free_runs.emplace(first, count);
+}
+
+inline void* FileBackedArena::take_slot(size_t page_index) {
+    PageInfo& page = pages[page_index];
+    size_t offset;
+    if (page.free_head != 0) {
+        offset = page.free_head - 1u;
+        page.free_head = *reinterpret_cast<uint16_t*>(base + page_index * page_size + offset);
+    } else {
+        offset = page.bump;
+        page.bump += page.size_class;
+    }
+    ++page.live;
+    return base + page_index * page_size + offset;
+}
+
+inline void* FileBackedArena::allocate(size_t bytes, size_t alignment, const void* hint) {
+    size_t size_class = class_of(bytes, alignment);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size_class > small_limit) {
+        return base + take_pages(round_up(bytes, page_size) / page_size) * page_size;
+    }
+    auto hint_address = static_cast<const char*>(hint);
+    if (hint_address >= base && hint_address < base + used_pages * page_size) {
+        size_t hint_page = static_cast<size_t>(hint_address - base) / page_size;
+        if (pages[hint_page].size_class == size_class && has_room(pages[hint_page])) {
+            return take_slot(hint_page);
+        }
+    }
+    size_t& open_page = open_pages[size_class / granularity];
+    if (open_page == npos || !has_room(pages[open_page])) {
+        open_page = npos;
+        auto& partial = partial_pages[size_class / granularity];
+        while (!partial.empty() && open_page == npos) {
+            size_t candidate = partial.back();
+            partial.pop_back();
+            if (pages[candidate].size_class == size_class && has_room(pages[candidate])) {
+                open_page = candidate;
+            }
+        }
+        if (open_page == npos) {
+            open_page = take_pages(1);
+            pages[open_page] = PageInfo{static_cast<uint16_t>(size_class), 0, 0, 0};
+        }
+    }
+    return take_slot(open_page);
+}
+
+inline void FileBackedArena::deallocate(void* pointer, size_t bytes, size_t alignment) {
+    size_t size_class = class_of(bytes, alignment);
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t page_index = static_cast<size_t>(static_cast<char*>(pointer) - base) / page_size;
+    if (size_class > small_limit) {
+        release_pages(page_index, round_up(bytes, page_size) / page_size);
+        return;
+    }
+    PageInfo& page = pages[page_index];
+    bool was_full = !has_room(page);
+    *static_cast<uint16_t*>(pointer) = page.free_head;
+    page.free_head = static_cast<uint16_t>(static_cast<char*>(pointer) - (base + page_index * page_size) + 1);
+    if (--page.live == 0 && open_pages[size_class / granularity] != page_index) {
+        page = PageInfo();
+        release_pages(page_index, 1);
+    } else if (was_full) {
+        partial_pages[size_class / granularity].push_back(page_index);
+    }
+}
+
+inline void FileBackedArena::advise(int advice) {
+    std::lock_guard<std::mutex> lock(mutex);
+    current_advice = advice;
+    if (mapped != 0) {
+        madvise(base, mapped, advice);
+    }
+}
+
+template<typename T>
+class FileBackedAllocator {
+    template<typename U>
+    friend class FileBackedAllocator;
+    std::shared_ptr<FileBackedArena> arena;
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit FileBackedAllocator(const std::string& directory
+            , size_t max_bytes = size_t(1) << 40
+            , size_t growth_bytes = size_t(64) << 20)
+            : arena(std::make_shared<FileBackedArena>(directory, max_bytes, growth_bytes)) {}
+    template<typename U>
+    FileBackedAllocator(const FileBackedAllocator<U>& other): arena(other.arena) {}
+
+    T* allocate(size_t count, const void* hint = nullptr) {
+        if (count > static_cast<size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T), hint));
+    }
+    void deallocate(T* pointer, size_t count) {
+        arena->deallocate(pointer, count * sizeof(T), alignof(T));
+    }
+    void advise(int advice) {
+        arena->advise(advice);
+    }
+    size_t mapped_bytes() const noexcept {
+        return arena->mapped_bytes();
+    }
+
+    template<typename U>
+    bool operator==(const FileBackedAllocator<U>& other) const noexcept {
+        return arena == other.arena;
+    }
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct HugePageAllocationException : std::bad_alloc {
+    const char* what() const noexcept override {
+        return "HugePageAllocationException";
+    }
+};
+
+// Carves small blocks (list nodes) out of 2 MiB chunks and maps large blocks
+// (bucket arrays) directly. Every mapping prefers MAP_HUGETLB, falls back to a
+// huge-page aligned mapping with MADV_HUGEPAGE, and is bound to numa_node
+// before first touch when a node is given.
+class HugePageArena {
+public:
+    static constexpr size_t huge_page_size = size_t(2) << 20;
+
+    explicit HugePageArena(int numa_node = -1): node(numa_node) {}
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+    ~HugePageArena() {
+        for (auto& chunk : chunks) {
+            munmap(chunk.first, chunk.second);
+        }
+    }
+
+    void* allocate(size_t bytes, size_t alignment);
+    void deallocate(void* pointer, size_t bytes, size_t alignment);
+    int numa_node() const noexcept {
+        return node;
+    }
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+    static constexpr size_t granularity = 16;
+    static constexpr size_t small_limit = 4096;
+
+    int node;
+    std::mutex mutex;
+    std::vector<std::pair<void*, size_t>> chunks;
+    char* cursor = nullptr;
+    char* chunk_end = nullptr;
+    FreeBlock* free_lists[small_limit / granularity] = {};
+
+    static size_t round_up(size_t value, size_t multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+    static bool is_large(size_t bytes, size_t alignment) {
+        return bytes > small_limit || alignment > small_limit;
+    }
+    // A class is a multiple of every alignment mapped to it, and each of its
+    // blocks is carved at the class's lowest set bit, so any freed block of a
+    // class satisfies every later request for that class.
+    static size_t class_of(size_t bytes, size_t alignment) {
+        return round_up(bytes, alignment > granularity ? alignment : granularity);
+    }
+    static size_t block_alignment(size_t size_class) {
+        return size_class & (~size_class + 1);
+    }
+    void* map_region(size_t bytes);
+    void bind_to_node(void* pointer, size_t bytes) const;
+};
+
+inline void HugePageArena::bind_to_node(void* pointer, size_t bytes) const {
+    if (node < 0) {
+        return;
+    }
+    constexpr size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(static_cast<size_t>(node) / bits + 1, 0);
+    mask[static_cast<size_t>(node) / bits] |= 1UL << (static_cast<size_t>(node) % bits);
+    constexpr int mpol_bind = 2;
+    // Failure leaves the default first-touch policy in place.
+    syscall(SYS_mbind, pointer, bytes, mpol_bind, mask.data(), mask.size() * bits + 1, 0);
+}
+
+inline void* HugePageArena::map_region(size_t bytes) {
+    void* region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (region == MAP_FAILED) {
+        size_t padded = bytes + huge_page_size;
+        void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw HugePageAllocationException();
+        }
+        auto raw_address = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = round_up(raw_address, huge_page_size);
+        if (aligned != raw_address) {
+            munmap(raw, aligned - raw_address);
+        }
+        size_t tail = raw_address + padded - (aligned + bytes);
+        if (tail != 0) {
+            munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+        }
+        region = reinterpret_cast<void*>(aligned);
+        madvise(region, bytes, MADV_HUGEPAGE);
+    }
+    bind_to_node(region, bytes);
+    return region;
+}
+
+inline void* HugePageArena::allocate(size_t bytes, size_t alignment) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    if (is_large(bytes, alignment)) {
+        return map_region(round_up(bytes, huge_page_size));
+    }
+    size_t size_class = class_of(bytes, alignment);
+    std::lock_guard<std::mutex> lock(mutex);
+    FreeBlock*& head = free_lists[size_class / granularity - 1];
+    if (head != nullptr) {
+        FreeBlock* block = head;
+        head = block->next;
+        return block;
+    }
+    auto aligned = reinterpret_cast<char*>(
+            round_up(reinterpret_cast<uintptr_t>(cursor), block_alignment(size_class)));
+    if (cursor == nullptr || aligned + size_class > chunk_end) {
+        void* chunk = map_region(huge_page_size);
+        chunks.emplace_back(chunk, huge_page_size);
+        cursor = static_cast<char*>(chunk);
+        chunk_end = cursor + huge_page_size;
+        aligned = cursor;
+    }
+    cursor = aligned + size_class;
+    return aligned;
+}
+
+inline void HugePageArena::deallocate(void* pointer, size_t bytes, size_t alignment) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    if (is_large(bytes, alignment)) {
+        munmap(pointer, round_up(bytes, huge_page_size));
+        return;
+    }
+    size_t size_class = class_of(bytes, alignment);
+    std::lock_guard<std::mutex> lock(mutex);
+    FreeBlock*& head = free_lists[size_class / granularity - 1];
+    head = new(pointer) FreeBlock{head};
+}
+
+template<typename T>
+class HugePageAllocator {
+    template<typename U>
+    friend class HugePageAllocator;
+    std::shared_ptr<HugePageArena> arena;
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit HugePageAllocator(int numa_node = -1)
+            : arena(std::make_shared<HugePageArena>(numa_node)) {}
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U>& other): arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        if (count > static_cast<size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* pointer, size_t count) {
+        arena->deallocate(pointer, count * sizeof(T), alignof(T));
+    }
+    int numa_node() const noexcept {
+        return arena->numa_node();
+    }
+
+    template<typename U>
+    bool operator==(const HugePageAllocator<U>& other) const noexcept {
+        return arena == other.arena;
+    }
+};
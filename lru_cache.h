@@ -0,0 +1,219 @@
+#pragma once
+
+#include "unordered_map.h"
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+enum class CachePolicy {
+    lru,
+    segmented_lru,
+};
+
+template<typename Key
+        , typename Value
+        , typename Hash = std::hash<Key>
+        , typename Equal = std::equal_to<Key>
+        , typename Alloc = std::allocator<std::pair<const Key, Value>>>
+class UnorderedLruCache {
+public:
+    using EvictionCallback = std::function<void(const Key&, Value&)>;
+private:
+    // Entries live in exactly one recency list; chain_next threads the same
+    // node through its bucket, so a lookup never needs a second container.
+    struct Entry {
+        std::pair<Key, Value> element;
+        size_t hash;
+        BaseNode* chain_next;
+        bool is_protected;
+    };
+    using AllocTraits = std::allocator_traits<Alloc>;
+    using EntryAlloc = typename AllocTraits::template rebind_alloc<Entry>;
+    using BucketAlloc = typename AllocTraits::template rebind_alloc<BaseNode*>;
+    using EntryList = List<Entry, EntryAlloc>;
+    using ListIt = typename EntryList::iterator;
+
+    constexpr static float protected_share = 0.8;
+    [[no_unique_address]] Hash hash;
+    [[no_unique_address]] Equal equal;
+    size_t max_entries;
+    size_t protected_capacity;
+    CachePolicy policy;
+    EntryList probation;
+    EntryList protected_entries;
+    std::vector<BaseNode*, BucketAlloc> buckets;
+    EvictionCallback on_evict;
+
+    static Entry& entry(BaseNode* node) {
+        return static_cast<TemplateNode<Entry>*>(node)->value;
+    }
+    BaseNode* const* find_link(const Key& key, size_t key_hash) const;
+    void unlink_from_bucket(BaseNode* node);
+    void touch(BaseNode* node);
+    void evict_one();
+public:
+    explicit UnorderedLruCache(size_t capacity
+            , CachePolicy policy = CachePolicy::lru
+            , const Hash& hash = Hash()
+            , const Equal& equal = Equal()
+            , const Alloc& alloc = Alloc());
+    UnorderedLruCache(const UnorderedLruCache& other) = delete;
+    UnorderedLruCache(UnorderedLruCache&& other) = default;
+    UnorderedLruCache& operator=(const UnorderedLruCache& other) = delete;
+    UnorderedLruCache& operator=(UnorderedLruCache&& other) = default;
+    size_t size() const;
+    size_t capacity() const;
+    bool contains(const Key& key) const;
+    Value* get(const Key& key);
+    const Value* peek(const Key& key) const;
+    void put(const Key& key, Value value);
+    bool erase(const Key& key);
+    void clear();
+    void set_eviction_callback(EvictionCallback callback);
+};
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::UnorderedLruCache(size_t capacity
+        , CachePolicy policy
+        , const Hash& hash
+        , const Equal& equal
+        , const Alloc& alloc)
+        : hash(hash)
+        , equal(equal)
+        , max_entries(capacity)
+        , protected_capacity(static_cast<size_t>(capacity * protected_share))
+        , policy(policy)
+        , probation(alloc)
+        , protected_entries(alloc)
+        , buckets(capacity + 1, nullptr, alloc) {}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::size() const {
+    return probation.size() + protected_entries.size();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::capacity() const {
+    return max_entries;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+BaseNode* const* UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::find_link(
+        const Key& key, size_t key_hash) const {
+    BaseNode* const* link = &buckets[key_hash % buckets.size()];
+    while (*link != nullptr) {
+        Entry& current = entry(*link);
+        if (current.hash == key_hash && equal(current.element.first, key)) {
+            break;
+        }
+        link = &current.chain_next;
+    }
+    return link;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::unlink_from_bucket(BaseNode* node) {
+    BaseNode** link = &buckets[entry(node).hash % buckets.size()];
+    while (*link != node) {
+        link = &entry(*link).chain_next;
+    }
+    *link = entry(node).chain_next;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::touch(BaseNode* node) {
+    Entry& touched = entry(node);
+    if (policy == CachePolicy::lru || touched.is_protected) {
+        EntryList& segment = touched.is_protected ? protected_entries : probation;
+        segment.splice(segment.begin(), segment, ListIt(node));
+        return;
+    }
+    touched.is_protected = true;
+    protected_entries.splice(protected_entries.begin(), probation, ListIt(node));
+    if (protected_entries.size() > protected_capacity) {
+        ListIt demoted = --protected_entries.end();
+        entry(demoted.return_base_node()).is_protected = false;
+        probation.splice(probation.begin(), protected_entries, demoted);
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::evict_one() {
+    EntryList& segment = probation.empty() ? protected_entries : probation;
+    ListIt victim = --segment.end();
+    unlink_from_bucket(victim.return_base_node());
+    if (on_evict) {
+        on_evict(victim->element.first, victim->element.second);
+    }
+    segment.erase(victim);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::contains(const Key& key) const {
+    return *find_link(key, hash(key)) != nullptr;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+Value* UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::get(const Key& key) {
+    BaseNode* node = *find_link(key, hash(key));
+    if (node == nullptr) {
+        return nullptr;
+    }
+    touch(node);
+    return &entry(node).element.second;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+const Value* UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::peek(const Key& key) const {
+    BaseNode* node = *find_link(key, hash(key));
+    return node == nullptr ? nullptr : &entry(node).element.second;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::put(const Key& key, Value value) {
+    size_t key_hash = hash(key);
+    BaseNode* node = *find_link(key, key_hash);
+    if (node != nullptr) {
+        entry(node).element.second = std::move(value);
+        touch(node);
+        return;
+    }
+    if (max_entries == 0) {
+        return;
+    }
+    if (size() == max_entries) {
+        evict_one();
+    }
+    BaseNode*& bucket = buckets[key_hash % buckets.size()];
+    node = probation.insert(probation.begin(),
+                            Entry{{key, std::move(value)}, key_hash, bucket, false}).return_base_node();
+    bucket = node;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::erase(const Key& key) {
+    BaseNode* node = *find_link(key, hash(key));
+    if (node == nullptr) {
+        return false;
+    }
+    unlink_from_bucket(node);
+    (entry(node).is_protected ? protected_entries : probation).erase(ListIt(node));
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::clear() {
+    while (!probation.empty()) {
+        probation.pop_back();
+    }
+    while (!protected_entries.empty()) {
+        protected_entries.pop_back();
+    }
+    buckets.assign(buckets.size(), nullptr);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedLruCache<Key, Value, Hash, Equal, Alloc>::set_eviction_callback(EvictionCallback callback) {
+    on_evict = std::move(callback);
+}
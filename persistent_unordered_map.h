@@ -0,0 +1,279 @@
+#pragma once
+
+#include "unordered_map.h"
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Hash array mapped trie with structural sharing. Copies and snapshot() share
+// the whole trie; a write copies only the nodes on its path that another
+// version still references, so a snapshot costs memory proportional to the
+// churn that happens after it.
+template<typename Key
+        , typename Value
+        , typename Hash = std::hash<Key>
+        , typename Equal = std::equal_to<Key>>
+class PersistentUnorderedMap {
+public:
+    using NodeType = std::pair<const Key, Value>;
+private:
+    using LowSecurityNodeType = std::pair<Key, Value>;
+    constexpr static size_t bits_per_level = 5;
+    constexpr static size_t hash_bits = 8 * sizeof(size_t);
+
+    // Below hash_bits a node is a bitmap-indexed branch holding inline entries
+    // and children; at hash_bits it is a collision bucket with entries only.
+    struct TrieNode {
+        uint32_t data_map = 0;
+        uint32_t node_map = 0;
+        std::vector<LowSecurityNodeType> data;
+        std::vector<size_t> hashes;
+        std::vector<std::shared_ptr<TrieNode>> children;
+    };
+    using TrieNodePtr = std::shared_ptr<TrieNode>;
+
+    [[no_unique_address]] Hash hash;
+    [[no_unique_address]] Equal equal;
+    TrieNodePtr root;
+    size_t element_count = 0;
+
+    static uint32_t bit_of(size_t key_hash, size_t shift) {
+        return uint32_t(1) << ((key_hash >> shift) & ((size_t(1) << bits_per_level) - 1));
+    }
+    static size_t index_of(uint32_t map, uint32_t bit) {
+        return static_cast<size_t>(std::popcount(map & (bit - 1)));
+    }
+    static TrieNode& editable(TrieNodePtr& node);
+    const LowSecurityNodeType* find_entry(const Key& key, size_t key_hash) const;
+    template<typename K, typename V>
+    bool insert_into(TrieNodePtr& node, size_t shift, size_t key_hash, K&& key, V&& value, bool assign);
+    void erase_from(TrieNodePtr& node, size_t shift, size_t key_hash, const Key& key);
+    template<typename Function>
+    static void for_each_in(const TrieNode& node, Function& function);
+public:
+    explicit PersistentUnorderedMap(const Hash& hash = Hash(), const Equal& equal = Equal())
+            : hash(hash), equal(equal), root(std::make_shared<TrieNode>()) {}
+    PersistentUnorderedMap snapshot() const;
+    size_t size() const;
+    bool empty() const;
+    bool contains(const Key& key) const;
+    const Value* find(const Key& key) const;
+    const Value& at(const Key& key) const;
+    bool insert(const Key& key, const Value& value);
+    bool insert_or_assign(const Key& key, const Value& value);
+    bool erase(const Key& key);
+    template<typename Function>
+    void for_each(Function function) const;
+};
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+typename PersistentUnorderedMap<Key, Value, Hash, Equal>::TrieNode&
+PersistentUnorderedMap<Key, Value, Hash, Equal>::editable(TrieNodePtr& node) {
+    if (node.use_count() == 1) {
+        // Pairs with the release decrement of the last other owner.
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } else {
+        node = std::make_shared<TrieNode>(*node);
+    }
+    return *node;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+PersistentUnorderedMap<Key, Value, Hash, Equal>
+PersistentUnorderedMap<Key, Value, Hash, Equal>::snapshot() const {
+    return *this;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+size_t PersistentUnorderedMap<Key, Value, Hash, Equal>::size() const {
+    return element_count;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+bool PersistentUnorderedMap<Key, Value, Hash, Equal>::empty() const {
+    return element_count == 0;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+const typename PersistentUnorderedMap<Key, Value, Hash, Equal>::LowSecurityNodeType*
+PersistentUnorderedMap<Key, Value, Hash, Equal>::find_entry(const Key& key, size_t key_hash) const {
+    const TrieNode* node = root.get();
+    for (size_t shift = 0; shift < hash_bits; shift += bits_per_level) {
+        uint32_t bit = bit_of(key_hash, shift);
+        if (node->data_map & bit) {
+            size_t index = index_of(node->data_map, bit);
+            if (node->hashes[index] == key_hash && equal(node->data[index].first, key)) {
+                return &node->data[index];
+            }
+            return nullptr;
+        }
+        if (!(node->node_map & bit)) {
+            return nullptr;
+        }
+        node = node->children[index_of(node->node_map, bit)].get();
+    }
+    for (size_t index = 0; index < node->data.size(); ++index) {
+        if (node->hashes[index] == key_hash && equal(node->data[index].first, key)) {
+            return &node->data[index];
+        }
+    }
+    return nullptr;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+bool PersistentUnorderedMap<Key, Value, Hash, Equal>::contains(const Key& key) const {
+    return find_entry(key, hash(key)) != nullptr;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+const Value* PersistentUnorderedMap<Key, Value, Hash, Equal>::find(const Key& key) const {
+    const LowSecurityNodeType* entry = find_entry(key, hash(key));
+    return entry == nullptr ? nullptr : &entry->second;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+const Value& PersistentUnorderedMap<Key, Value, Hash, Equal>::at(const Key& key) const {
+    const Value* value = find(key);
+    if (value == nullptr) {
+        throw UnorderedMapAtKeyNotFoundException();
+    }
+    return *value;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+template<typename K, typename V>
+bool PersistentUnorderedMap<Key, Value, Hash, Equal>::insert_into(
+        TrieNodePtr& node, size_t shift, size_t key_hash, K&& key, V&& value, bool assign) {
+    TrieNode& current = editable(node);
+    if (shift >= hash_bits) {
+        for (size_t index = 0; index < current.data.size(); ++index) {
+            if (current.hashes[index] == key_hash && equal(current.data[index].first, key)) {
+                if (assign) {
+                    current.data[index].second = std::forward<V>(value);
+                }
+                return false;
+            }
+        }
+        current.data.emplace_back(std::forward<K>(key), std::forward<V>(value));
+        current.hashes.push_back(key_hash);
+        return true;
+    }
+    uint32_t bit = bit_of(key_hash, shift);
+    if (current.node_map & bit) {
+        return insert_into(current.children[index_of(current.node_map, bit)],
+                           shift + bits_per_level, key_hash, std::forward<K>(key), std::forward<V>(value), assign);
+    }
+    size_t index = index_of(current.data_map, bit);
+    if (!(current.data_map & bit)) {
+        current.data.emplace(current.data.begin() + index, std::forward<K>(key), std::forward<V>(value));
+        current.hashes.insert(current.hashes.begin() + index, key_hash);
+        current.data_map |= bit;
+        return true;
+    }
+    if (current.hashes[index] == key_hash && equal(current.data[index].first, key)) {
+        if (assign) {
+            current.data[index].second = std::forward<V>(value);
+        }
+        return false;
+    }
+    auto child = std::make_shared<TrieNode>();
+    insert_into(child, shift + bits_per_level, current.hashes[index],
+                std::move(current.data[index].first), std::move(current.data[index].second), false);
+    insert_into(child, shift + bits_per_level, key_hash, std::forward<K>(key), std::forward<V>(value), false);
+    current.data.erase(current.data.begin() + index);
+    current.hashes.erase(current.hashes.begin() + index);
+    current.data_map &= ~bit;
+    current.node_map |= bit;
+    current.children.insert(current.children.begin() + index_of(current.node_map, bit), std::move(child));
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+bool PersistentUnorderedMap<Key, Value, Hash, Equal>::insert(const Key& key, const Value& value) {
+    size_t key_hash = hash(key);
+    if (find_entry(key, key_hash) != nullptr) {
+        return false;
+    }
+    insert_into(root, 0, key_hash, key, value, false);
+    ++element_count;
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+bool PersistentUnorderedMap<Key, Value, Hash, Equal>::insert_or_assign(const Key& key, const Value& value) {
+    bool inserted = insert_into(root, 0, hash(key), key, value, true);
+    element_count += inserted;
+    return inserted;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+void PersistentUnorderedMap<Key, Value, Hash, Equal>::erase_from(
+        TrieNodePtr& node, size_t shift, size_t key_hash, const Key& key) {
+    TrieNode& current = editable(node);
+    if (shift >= hash_bits) {
+        for (size_t index = 0; index < current.data.size(); ++index) {
+            if (current.hashes[index] == key_hash && equal(current.data[index].first, key)) {
+                current.data.erase(current.data.begin() + index);
+                current.hashes.erase(current.hashes.begin() + index);
+                return;
+            }
+        }
+        return;
+    }
+    uint32_t bit = bit_of(key_hash, shift);
+    if (current.data_map & bit) {
+        size_t index = index_of(current.data_map, bit);
+        current.data.erase(current.data.begin() + index);
+        current.hashes.erase(current.hashes.begin() + index);
+        current.data_map &= ~bit;
+        return;
+    }
+    size_t child_index = index_of(current.node_map, bit);
+    TrieNodePtr& child = current.children[child_index];
+    erase_from(child, shift + bits_per_level, key_hash, key);
+    if (!child->children.empty() || child->data.size() > 1) {
+        return;
+    }
+    if (child->data.size() == 1) {
+        size_t index = index_of(current.data_map, bit);
+        size_t moved_hash = child->hashes.front();
+        current.data.insert(current.data.begin() + index, std::move(child->data.front()));
+        current.hashes.insert(current.hashes.begin() + index, moved_hash);
+        current.data_map |= bit;
+    }
+    current.children.erase(current.children.begin() + child_index);
+    current.node_map &= ~bit;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+bool PersistentUnorderedMap<Key, Value, Hash, Equal>::erase(const Key& key) {
+    size_t key_hash = hash(key);
+    if (find_entry(key, key_hash) == nullptr) {
+        return false;
+    }
+    erase_from(root, 0, key_hash, key);
+    --element_count;
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+template<typename Function>
+void PersistentUnorderedMap<Key, Value, Hash, Equal>::for_each_in(const TrieNode& node, Function& function) {
+    for (const auto& entry : node.data) {
+        function(*reinterpret_cast<const NodeType*>(&entry));
+    }
+    for (const auto& child : node.children) {
+        for_each_in(*child, function);
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal>
+template<typename Function>
+void PersistentUnorderedMap<Key, Value, Hash, Equal>::for_each(Function function) const {
+    for_each_in(*root, function);
+}
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+struct SharedMemoryAllocationException : std::bad_alloc {
+    const char* what() const noexcept override {
+        return "SharedMemoryAllocationException";
+    }
+};
+
+struct SharedMemorySegmentException : std::runtime_error {
+    explicit SharedMemorySegmentException(const std::string& what)
+            : std::runtime_error("SharedMemorySegmentException: " + what) {}
+};
+
+// Reader-writer lock usable from every process that maps the segment it
+// lives in. Satisfies SharedMutex, so std::shared_lock and std::unique_lock
+// work with it.
+class ProcessSharedMutex {
+    pthread_rwlock_t rwlock;
+public:
+    ProcessSharedMutex() {
+        pthread_rwlockattr_t attributes;
+        pthread_rwlockattr_init(&attributes);
+        pthread_rwlockattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+        pthread_rwlock_init(&rwlock, &attributes);
+        pthread_rwlockattr_destroy(&attributes);
+    }
+    ProcessSharedMutex(const ProcessSharedMutex&) = delete;
+    ProcessSharedMutex& operator=(const ProcessSharedMutex&) = delete;
+    ~ProcessSharedMutex() {
+        pthread_rwlock_destroy(&rwlock);
+    }
+    void lock() {
+        pthread_rwlock_wrlock(&rwlock);
+    }
+    bool try_lock() {
+        return pthread_rwlock_trywrlock(&rwlock) == 0;
+    }
+    void unlock() {
+        pthread_rwlock_unlock(&rwlock);
+    }
+    void lock_shared() {
+        pthread_rwlock_rdlock(&rwlock);
+    }
+    bool try_lock_shared() {
+        return pthread_rwlock_tryrdlock(&rwlock) == 0;
+    }
+    void unlock_shared() {
+        pthread_rwlock_unlock(&rwlock);
+    }
+};
+
+// Allocator state stored at the start of the segment itself, so any process
+// can allocate and free. Blocks come in power-of-two classes with one free
+// list each; a block never returns to the bump region.
+class SharedMemoryHeap {
+public:
+    static constexpr size_t max_alignment = 64;
+    static constexpr size_t max_objects = 32;
+    static constexpr size_t max_name_length = 55;
+
+    SharedMemoryHeap(void* base, size_t bytes);
+    SharedMemoryHeap(const SharedMemoryHeap&) = delete;
+    SharedMemoryHeap& operator=(const SharedMemoryHeap&) = delete;
+    ~SharedMemoryHeap() {
+        pthread_mutex_destroy(&mutex);
+    }
+
+    void* allocate(size_t bytes, size_t alignment);
+    void deallocate(void* pointer, size_t bytes, size_t alignment);
+    size_t used_bytes() const noexcept {
+        return used;
+    }
+    size_t capacity_bytes() const noexcept {
+        return capacity;
+    }
+private:
+    friend class SharedMemorySegment;
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+    struct NamedObject {
+        char name[max_name_length + 1];
+        void* object;
+    };
+    static constexpr uint64_t magic_value = 0x31504d48444d4853ULL;
+    static constexpr size_t min_class_bits = 4;
+    static constexpr size_t class_count = 64 - min_class_bits;
+
+    uint64_t magic;
+    void* base;
+    size_t capacity;
+    size_t used;
+    pthread_mutex_t mutex;
+    FreeBlock* free_lists[class_count] = {};
+    NamedObject objects[max_objects] = {};
+    ProcessSharedMutex objects_mutex;
+
+    static size_t class_of(size_t bytes, size_t alignment) {
+        size_t rounded = std::bit_ceil(std::max({bytes, alignment, size_t(1) << min_class_bits}));
+        return static_cast<size_t>(std::countr_zero(rounded)) - min_class_bits;
+    }
+    void lock() {
+        pthread_mutex_lock(&mutex);
+    }
+    void unlock() {
+        pthread_mutex_unlock(&mutex);
+    }
+};
+
+inline SharedMemoryHeap::SharedMemoryHeap(void* base, size_t bytes)
+        : magic(magic_value), base(base), capacity(bytes) {
+    used = (sizeof(SharedMemoryHeap) + max_alignment - 1) / max_alignment * max_alignment;
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+
+inline void* SharedMemoryHeap::allocate(size_t bytes, size_t alignment) {
+    if (alignment > max_alignment || bytes > capacity) {
+        throw SharedMemoryAllocationException();
+    }
+    size_t size_class = class_of(bytes, alignment);
+    size_t block_bytes = size_t(1) << (size_class + min_class_bits);
+    lock();
+    if (FreeBlock* block = free_lists[size_class]) {
+        free_lists[size_class] = block->next;
+        unlock();
+        return block;
+    }
+    size_t block_alignment = std::min(block_bytes, max_alignment);
+    size_t offset = (used + block_alignment - 1) / block_alignment * block_alignment;
+    if (offset + block_bytes > capacity) {
+        unlock();
+        throw SharedMemoryAllocationException();
+    }
+    used = offset + block_bytes;
+    unlock();
+    return static_cast<char*>(base) + offset;
+}
+
+inline void SharedMemoryHeap::deallocate(void* pointer, size_t bytes, size_t alignment) {
+    size_t size_class = class_of(bytes, alignment);
+    lock();
+    free_lists[size_class] = ::new(pointer) FreeBlock{free_lists[size_class]};
+    unlock();
+}
+
+// A POSIX shared memory object mapped at the same address in every process.
+// Because the address never differs, raw pointers stored inside the segment
+// (list links, bucket heads, allocator handles) are valid everywhere and no
+// pointer translation is needed. The creating process picks the address.
+//
+// An UnorderedMap built here with construct() and a SharedMemoryAllocator is
+// readable by every attached process, provided its keys and values own no
+// process-local memory and treeify and access sampling stay off: those
+// indexes live on the process heap. Guard it with a ProcessSharedMutex
+// constructed in the same segment.
+class SharedMemorySegment {
+public:
+    static constexpr uintptr_t default_address = 0x500000000000;
+
+    // Creates the object; fails if it already exists or the address is taken.
+    SharedMemorySegment(const std::string& name, size_t bytes
+            , void* address = reinterpret_cast<void*>(default_address));
+    // Attaches to an existing object at the address its creator chose.
+    explicit SharedMemorySegment(const std::string& name);
+    SharedMemorySegment(const SharedMemorySegment&) = delete;
+    SharedMemorySegment& operator=(const SharedMemorySegment&) = delete;
+    ~SharedMemorySegment() {
+        munmap(heap_pointer, mapped_bytes);
+    }
+    static void remove(const std::string& name) {
+        shm_unlink(name.c_str());
+    }
+
+    SharedMemoryHeap& heap() noexcept {
+        return *heap_pointer;
+    }
+    template<typename T, typename... Args>
+    T& construct(const std::string& name, Args&&... args);
+    template<typename T>
+    T* find(const std::string& name);
+    template<typename T>
+    bool destroy(const std::string& name);
+private:
+    SharedMemoryHeap* heap_pointer;
+    size_t mapped_bytes;
+
+    static void* map_at(int file, size_t bytes, void* address);
+    SharedMemoryHeap::NamedObject* slot_of(const std::string& name);
+};
+
+inline void* SharedMemorySegment::map_at(int file, size_t bytes, void* address) {
+    void* mapping = mmap(address, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, file, 0);
+    if (mapping != MAP_FAILED && mapping != address) {
+        munmap(mapping, bytes);
+        mapping = MAP_FAILED;
+    }
+    return mapping;
+}
+
+inline SharedMemorySegment::SharedMemorySegment(const std::string& name, size_t bytes, void* address)
+        : mapped_bytes(bytes) {
+    if (bytes <= sizeof(SharedMemoryHeap) || reinterpret_cast<uintptr_t>(address) % sysconf(_SC_PAGESIZE) != 0) {
+        throw SharedMemorySegmentException("bad size or address for " + name);
+    }
+    int file = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (file < 0) {
+        throw SharedMemorySegmentException("cannot create " + name);
+    }
+    void* mapping = ftruncate(file, static_cast<off_t>(bytes)) == 0 ? map_at(file, bytes, address) : MAP_FAILED;
+    close(file);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw SharedMemorySegmentException("cannot map " + name);
+    }
+    heap_pointer = ::new(mapping) SharedMemoryHeap(mapping, bytes);
+}
+
+inline SharedMemorySegment::SharedMemorySegment(const std::string& name) {
+    int file = shm_open(name.c_str(), O_RDWR, 0600);
+    if (file < 0) {
+        throw SharedMemorySegmentException("cannot open " + name);
+    }
+    void* probe = mmap(nullptr, sizeof(SharedMemoryHeap), PROT_READ, MAP_SHARED, file, 0);
+    if (probe == MAP_FAILED) {
+        close(file);
+        throw SharedMemorySegmentException("cannot map " + name);
+    }
+    const auto* header = static_cast<const SharedMemoryHeap*>(probe);
+    bool valid = header->magic == SharedMemoryHeap::magic_value;
+    void* address = header->base;
+    mapped_bytes = header->capacity;
+    munmap(probe, sizeof(SharedMemoryHeap));
+    void* mapping = valid ? map_at(file, mapped_bytes, address) : MAP_FAILED;
+    close(file);
+    if (mapping == MAP_FAILED) {
+        throw SharedMemorySegmentException(valid ? "address in use for " + name : "bad header in " + name);
+    }
+    heap_pointer = static_cast<SharedMemoryHeap*>(mapping);
+}
+
+inline SharedMemoryHeap::NamedObject* SharedMemorySegment::slot_of(const std::string& name) {
+    for (auto& object : heap_pointer->objects) {
+        if (object.object != nullptr && name == object.name) {
+            return &object;
+        }
+    }
+    return nullptr;
+}
+
+template<typename T, typename... Args>
+T& SharedMemorySegment::construct(const std::string& name, Args&&... args) {
+    std::lock_guard<ProcessSharedMutex> lock(heap_pointer->objects_mutex);
+    if (name.size() > SharedMemoryHeap::max_name_length || slot_of(name) != nullptr) {
+        throw SharedMemorySegmentException("cannot construct " + name);
+    }
+    for (auto& object : heap_pointer->objects) {
+        if (object.object == nullptr) {
+            void* memory = heap_pointer->allocate(sizeof(T), alignof(T));
+            T* result;
+            try {
+                result = ::new(memory) T(std::forward<Args>(args)...);
+            } catch (...) {
+                heap_pointer->deallocate(memory, sizeof(T), alignof(T));
+                throw;
+            }
+            std::memcpy(object.name, name.c_str(), name.size() + 1);
+            object.object = result;
+            return *result;
+        }
+    }
+    throw SharedMemorySegmentException("no free object slot for " + name);
+}
+
+template<typename T>
+T* SharedMemorySegment::find(const std::string& name) {
+    std::shared_lock<ProcessSharedMutex> lock(heap_pointer->objects_mutex);
+    SharedMemoryHeap::NamedObject* object = slot_of(name);
+    return object == nullptr ? nullptr : static_cast<T*>(object->object);
+}
+
+template<typename T>
+bool SharedMemorySegment::destroy(const std::string& name) {
+    std::lock_guard<ProcessSharedMutex> lock(heap_pointer->objects_mutex);
+    SharedMemoryHeap::NamedObject* object = slot_of(name);
+    if (object == nullptr) {
+        return false;
+    }
+    T* pointer = static_cast<T*>(object->object);
+    pointer->~T();
+    heap_pointer->deallocate(pointer, sizeof(T), alignof(T));
+    object->object = nullptr;
+    return true;
+}
+
+// Holds a plain pointer to the heap inside the segment, which is valid in
+// every attached process, so containers built in the segment can be used by
+// all of them.
+template<typename T>
+class SharedMemoryAllocator {
+    template<typename U>
+    friend class SharedMemoryAllocator;
+    SharedMemoryHeap* heap;
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit SharedMemoryAllocator(SharedMemorySegment& segment): heap(&segment.heap()) {}
+    template<typename U>
+    SharedMemoryAllocator(const SharedMemoryAllocator<U>& other): heap(other.heap) {}
+
+    T* allocate(size_t count) {
+        if (count > static_cast<size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(heap->allocate(count * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* pointer, size_t count) {
+        heap->deallocate(pointer, count * sizeof(T), alignof(T));
+    }
+
+    template<typename U>
+    bool operator==(const SharedMemoryAllocator<U>& other) const noexcept {
+        return heap == other.heap;
+    }
+};
@@ -0,0 +1,236 @@
+// Replays a workload trace against UnorderedMap and reference containers.
+//
+//   g++ -std=c++20 -O2 -I.. trace_replay.cpp -o trace_replay
+//   ./trace_replay run.trace                 replay a captured trace
+//   ./trace_replay --synthesize run.trace N  write a synthetic N-op trace
+
+#include "../unordered_map.h"
+#include "../workload_trace.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Log-linear latency histogram: every power of two is split into 32 linear
+// sub-buckets, keeping relative error under about 3% up to 2^63 ns.
+class LatencyHistogram {
+    static constexpr size_t sub_bucket_bits = 5;
+    static constexpr size_t sub_buckets = size_t(1) << sub_bucket_bits;
+    std::vector<uint64_t> counts = std::vector<uint64_t>(64 * sub_buckets, 0);
+    uint64_t total = 0;
+    uint64_t max_value = 0;
+
+    static size_t index_of(uint64_t value) {
+        if (value < sub_buckets) {
+            return value;
+        }
+        size_t magnitude = 63 - __builtin_clzll(value);
+        size_t shift = magnitude - sub_bucket_bits;
+        size_t sub = (value >> shift) - sub_buckets;
+        return (magnitude - sub_bucket_bits + 1) * sub_buckets + sub;
+    }
+    static uint64_t upper_bound_of(size_t index) {
+        if (index < sub_buckets) {
+            return index;
+        }
+        size_t shift = index / sub_buckets - 1;
+        uint64_t sub = index % sub_buckets + sub_buckets;
+        return ((sub + 1) << shift) - 1;
+    }
+public:
+    void record(uint64_t value) {
+        ++counts[index_of(value)];
+        ++total;
+        max_value = std::max(max_value, value);
+    }
+    uint64_t count() const {
+        return total;
+    }
+    uint64_t max() const {
+        return max_value;
+    }
+    uint64_t percentile(double p) const {
+        auto rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen > rank) {
+                return std::min(upper_bound_of(i), max_value);
+            }
+        }
+        return max_value;
+    }
+};
+
+size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    statm >> total_pages >> resident_pages;
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+struct ReplayReport {
+    LatencyHistogram latencies[4];
+    std::vector<std::pair<size_t, size_t>> rss_samples;
+    std::vector<std::pair<size_t, uint64_t>> rehash_points;
+    size_t final_size = 0;
+    double seconds = 0;
+};
+
+template<typename Map>
+ReplayReport replay(const std::vector<TraceRecord>& trace) {
+    constexpr size_t rss_period = size_t(1) << 16;
+    using Clock = std::chrono::steady_clock;
+    ReplayReport report;
+    Map map;
+    size_t buckets = 0;
+    if constexpr (requires { map.bucket_count(); }) {
+        buckets = map.bucket_count();
+    }
+    auto start = Clock::now();
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const TraceRecord& record = trace[i];
+        auto before = Clock::now();
+        switch (record.op) {
+            case TraceOp::insert:
+                map[record.key] = std::string(record.value_size, 'v');
+                break;
+            case TraceOp::find: {
+                auto it = map.find(record.key);
+                asm volatile("" : : "r"(&it) : "memory");
+                break;
+            }
+            case TraceOp::erase: {
+                auto it = map.find(record.key);
+                if (it != map.end()) {
+                    map.erase(it);
+                }
+                break;
+            }
+            case TraceOp::access: {
+                std::string& value = map[record.key];
+                asm volatile("" : : "r"(&value) : "memory");
+                break;
+            }
+        }
+        auto elapsed = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - before).count());
+        report.latencies[static_cast<size_t>(record.op)].record(elapsed);
+        if constexpr (requires { map.bucket_count(); }) {
+            if (map.bucket_count() != buckets) {
+                buckets = map.bucket_count();
+                report.rehash_points.emplace_back(i, elapsed);
+            }
+        }
+        if (i % rss_period == 0) {
+            report.rss_samples.emplace_back(i, resident_bytes());
+        }
+    }
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report.rss_samples.emplace_back(trace.size(), resident_bytes());
+    report.final_size = map.size();
+    return report;
+}
+
+void print_report(const char* name, const ReplayReport& report) {
+    static const char* op_names[4] = {"insert", "find", "erase", "access"};
+    static const double percentiles[] = {50, 90, 99, 99.9, 99.99};
+    std::printf("== %s: %.3f s, final size %zu\n", name, report.seconds, report.final_size);
+    std::printf("   %-7s %12s %8s %8s %8s %8s %8s %10s\n",
+                "op", "count", "p50", "p90", "p99", "p99.9", "p99.99", "max (ns)");
+    for (size_t op = 0; op < 4; ++op) {
+        const LatencyHistogram& histogram = report.latencies[op];
+        if (histogram.count() == 0) {
+            continue;
+        }
+        std::printf("   %-7s %12llu", op_names[op], static_cast<unsigned long long>(histogram.count()));
+        for (double p : percentiles) {
+            std::printf(" %8llu", static_cast<unsigned long long>(histogram.percentile(p)));
+        }
+        std::printf(" %10llu\n", static_cast<unsigned long long>(histogram.max()));
+    }
+    std::printf("   rss (op, MiB):");
+    for (const auto& [op, bytes] : report.rss_samples) {
+        std::printf(" %zu:%.1f", op, static_cast<double>(bytes) / (1 << 20));
+    }
+    std::printf("\n   rehash (op, ns):");
+    for (const auto& [op, nanoseconds] : report.rehash_points) {
+        std::printf(" %zu:%llu", op, static_cast<unsigned long long>(nanoseconds));
+    }
+    std::printf("\n");
+}
+
+void synthesize(const std::string& path, size_t operations) {
+    TraceWriter writer(path);
+    std::mt19937_64 random(42);
+    uint64_t key_space = operations / 4 + 1;
+    for (size_t i = 0; i < operations; ++i) {
+        uint64_t roll = random() % 100;
+        TraceOp op = roll < 30 ? TraceOp::insert : roll < 90 ? TraceOp::find : TraceOp::erase;
+        writer.write({op, random() % key_space, op == TraceOp::insert ? static_cast<uint32_t>(random() % 64) : 0});
+    }
+}
+
+// Each container replays in its own child process: resident_bytes() is
+// process-wide, and memory the allocator kept from an earlier replay would
+// otherwise show up in the next one's RSS samples.
+template<typename Map>
+bool replay_isolated(const char* name, const std::vector<TraceRecord>& trace) {
+    std::fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        std::perror("fork");
+        return false;
+    }
+    if (child == 0) {
+        print_report(name, replay<Map>(trace));
+        std::fflush(stdout);
+        _exit(0);
+    }
+    int status = 0;
+    if (waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::fprintf(stderr, "%s replay failed\n", name);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 4 && std::string(argv[1]) == "--synthesize") {
+        synthesize(argv[2], std::strtoull(argv[3], nullptr, 10));
+        return 0;
+    }
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <trace> | --synthesize <trace> <operations>\n", argv[0]);
+        return 2;
+    }
+    std::vector<TraceRecord> trace;
+    try {
+        TraceReader reader(argv[1]);
+        TraceRecord record{};
+        while (reader.next(record)) {
+            trace.push_back(record);
+        }
+    } catch (const TraceFormatException& error) {
+        std::fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+    std::printf("%zu operations\n", trace.size());
+    bool replayed = replay_isolated<UnorderedMap<uint64_t, std::string>>("UnorderedMap", trace);
+    replayed &= replay_isolated<std::unordered_map<uint64_t, std::string>>("std::unordered_map", trace);
+    replayed &= replay_isolated<std::map<uint64_t, std::string>>("std::map", trace);
+    return replayed ? 0 : 1;
+}
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <new>
 #include <stdexcept>
 #include <cassert>
 #include <type_traits>
+#include <vector>
 
 template<typename Key
         , typename Value
@@ -54,6 +57,15 @@ private:
     using NodeAllocTraits = std::allocator_traits<NodeAlloc>;
     BaseNode root;
     size_t list_size;
+    // Blocks holding several nodes, allocated by compact() and sorted by
+    // address; a block goes back to the allocator once its last node dies.
+    struct Slab {
+        Node* first;
+        size_t capacity;
+        size_t live;
+    };
+    using SlabAlloc = typename AllocTraits::template rebind_alloc<Slab>;
+    std::vector<Slab, SlabAlloc> slabs;
 
     template<typename Value>
     // NOLINTNEXTLINE
@@ -120,6 +132,7 @@ private:
     };
     void switch_alloc(const Alloc& other);
     void move_ones_nodes_to_the_other(List&& other);
+    void release_node(Node* node);
 public:
     using iterator = BaseIterator<value_type>;
     using const_iterator = BaseIterator<const value_type>;
@@ -167,17 +180,24 @@ public:
     BaseIterator<Value> insert(BaseIterator<Value> it, value_type&& value);
     template<typename Value>
     BaseIterator<Value> erase(BaseIterator<Value> it);
+    template<typename Value>
+    BaseIterator<Value> erase(BaseIterator<Value> first, BaseIterator<Value> last);
+    template<typename Value>
+    void splice(BaseIterator<Value> position, List& other, BaseIterator<Value> it);
+    void compact();
 };
 
 template<typename T, typename Alloc>
-List<T, Alloc>::List(const Alloc& allocator): NodeAlloc(allocator), root(BaseNode()), list_size(0) {}
+List<T, Alloc>::List(const Alloc& allocator)
+        : NodeAlloc(allocator), root(BaseNode()), list_size(0), slabs(SlabAlloc(allocator)) {}
 
 
 template<typename T, typename Alloc>
 List<T, Alloc>::List(size_t size, const value_type& value, const Alloc& allocator)
         : NodeAlloc(allocator)
         , root(BaseNode())
-        , list_size(0) {
+        , list_size(0)
+        , slabs(SlabAlloc(allocator)) {
     pointer_inserter(end(), &value, size);
 }
 
@@ -193,7 +213,8 @@ template<typename T, typename Alloc>
 List<T, Alloc>::List(size_t size, const Alloc& allocator)
         : NodeAlloc(allocator)
         , root(BaseNode())
-        , list_size(0) {
+        , list_size(0)
+        , slabs(SlabAlloc(allocator)) {
     pointer_inserter(end(), nullptr,size);
 }
 
@@ -201,7 +222,8 @@ template<typename T, typename Alloc>
 List<T, Alloc>::List(const List& other)
         : NodeAlloc(AllocTraits::select_on_container_copy_construction(
         other.get_allocator()))
-        , list_size(0) {
+        , list_size(0)
+        , slabs(SlabAlloc(static_cast<const NodeAlloc&>(*this))) {
     try {
         for (auto it = other.begin(); it != other.end(); ++it) {
             push_back(*it);
@@ -216,10 +238,10 @@ List<T, Alloc>::List(const List& other)
 
 template<typename T, typename Alloc>
 List<T, Alloc>::List(List&& other)
-        : list_size(0) {
+        : NodeAlloc(static_cast<const NodeAlloc&>(other))
+        , list_size(0)
+        , slabs(std::move(other.slabs)) {
     try {
-        const NodeAlloc& other_alloc = other;
-        switch_alloc(other_alloc);
         while (!other.empty()) {
             auto it = other.begin();
             BaseNode* node = it.return_base_node();
@@ -333,6 +355,7 @@ List<T, Alloc>& List<T, Alloc>::operator=(List&& other) {
         const NodeAlloc& other_alloc = other;
         if (alloc == other_alloc) {
             move_ones_nodes_to_the_other(std::move(other));
+            slabs = std::move(other.slabs);
             return *this;
         } else {
             while (!other.empty()) {
@@ -460,7 +483,7 @@ typename List<T, Alloc>::template BaseIterator<Value> List<T, Alloc>::pointer_in
         for (; instance < number_of_elements; ++instance) {
             BaseNode* insertion_node = it.node;
             BaseNode* previos_node = insertion_node->previous;
-            new_node = NodeAllocTraits::allocate(*this, 1);
+            new_node = NodeAllocTraits::allocate(*this, 1, insertion_node);
             try {
                 if (value == nullptr) {
                     if constexpr (std::is_default_constructible<value_type>::value) {
@@ -505,7 +528,7 @@ typename List<T, Alloc>::template BaseIterator<Value> List<T, Alloc>::insert(
         for (; instance < number_of_elements; ++instance) {
             BaseNode* insertion_node = it.node;
             BaseNode* previos_node = insertion_node->previous;
-            new_node = NodeAllocTraits::allocate(*this, 1);
+            new_node = NodeAllocTraits::allocate(*this, 1, insertion_node);
             try {
                 NodeAllocTraits::construct(*this, new_node, previos_node, insertion_node, std::move(value));
             } catch(...) {
@@ -533,8 +556,7 @@ typename List<T, Alloc>::template BaseIterator<Value> List<T, Alloc>::erase(
     BaseNode* erasing_node = it.node;
     BaseNode* next = erasing_node->next;
     BaseNode* previous = erasing_node->previous;
-    NodeAllocTraits::destroy(*this, static_cast<Node*>(erasing_node));
-    NodeAllocTraits::deallocate(*this, static_cast<Node*>(erasing_node), 1);
+    release_node(static_cast<Node*>(erasing_node));
     erasing_node = nullptr;
     next->previous = previous;
     previous->next = next;
@@ -542,12 +564,422 @@ typename List<T, Alloc>::template BaseIterator<Value> List<T, Alloc>::erase(
     return iterator(next);
 }
 
+template<typename T, typename Alloc>
+template<typename Value>
+typename List<T, Alloc>::template BaseIterator<Value> List<T, Alloc>::erase(
+        BaseIterator<Value> first, BaseIterator<Value> last) {
+    if (first == last) {
+        return last;
+    }
+    BaseNode* erasing_node = first.node;
+    erasing_node->previous->next = last.node;
+    last.node->previous = erasing_node->previous;
+    while (erasing_node != last.node) {
+        BaseNode* next = erasing_node->next;
+        release_node(static_cast<Node*>(erasing_node));
+        erasing_node = next;
+        --list_size;
+    }
+    return last;
+}
+
+template<typename T, typename Alloc>
+void List<T, Alloc>::release_node(Node* node) {
+    NodeAllocTraits::destroy(*this, node);
+    if (!slabs.empty()) {
+        auto slab = std::upper_bound(slabs.begin(), slabs.end(), node, [](Node* pointer, const Slab& current) {
+            return std::less<Node*>()(pointer, current.first);
+        });
+        if (slab != slabs.begin() && std::less<Node*>()(node, (--slab)->first + slab->capacity)) {
+            if (--slab->live == 0) {
+                NodeAllocTraits::deallocate(*this, slab->first, slab->capacity);
+                slabs.erase(slab);
+            }
+            return;
+        }
+    }
+    NodeAllocTraits::deallocate(*this, node, 1);
+}
 
+template<typename T, typename Alloc>
+void List<T, Alloc>::compact() {
+    if (list_size == 0) {
+        return;
+    }
+    Node* block = NodeAllocTraits::allocate(*this, list_size);
+    size_t constructed = 0;
+    try {
+        for (BaseNode* node = root.next; node != &root; node = node->next, ++constructed) {
+            NodeAllocTraits::construct(*this, block + constructed, nullptr, nullptr,
+                                       std::move_if_noexcept(static_cast<Node*>(node)->value));
+        }
+    } catch (...) {
+        while (constructed--) {
+            NodeAllocTraits::destroy(*this, block + constructed);
+        }
+        NodeAllocTraits::deallocate(*this, block, list_size);
+        throw;
+    }
+    for (BaseNode* node = root.next; node != &root;) {
+        BaseNode* next = node->next;
+        release_node(static_cast<Node*>(node));
+        node = next;
+    }
+    BaseNode* previous = &root;
+    for (size_t index = 0; index < list_size; ++index) {
+        block[index].previous = previous;
+        previous->next = block + index;
+        previous = block + index;
+    }
+    previous->next = &root;
+    root.previous = previous;
+    auto position = std::upper_bound(slabs.begin(), slabs.end(), block, [](Node* pointer, const Slab& current) {
+        return std::less<Node*>()(pointer, current.first);
+    });
+    slabs.insert(position, Slab{block, list_size, list_size});
+}
+
+template<typename T, typename Alloc>
+template<typename Value>
+void List<T, Alloc>::splice(BaseIterator<Value> position, List& other, BaseIterator<Value> it) {
+    BaseNode* moving_node = it.node;
+    BaseNode* insertion_node = position.node;
+    if (moving_node == insertion_node || moving_node->next == insertion_node) {
+        return;
+    }
+    moving_node->previous->next = moving_node->next;
+    moving_node->next->previous = moving_node->previous;
+    moving_node->previous = insertion_node->previous;
+    moving_node->next = insertion_node;
+    insertion_node->previous->next = moving_node;
+    insertion_node->previous = moving_node;
+    --other.list_size;
+    ++list_size;
+}
+
+
+#include <exception>
 #include <initializer_list>
+#include <map>
+#include <mutex>
+#include <set>
 #include <stdexcept>
 #include <cmath>
+#include <thread>
 #include <utility>
-#include <vector>
+#include <cstdint>
+
+template<typename Alloc = std::allocator<uint64_t>>
+class BlockedBloomFilter {
+    struct alignas(64) Block {
+        uint64_t words[8] = {};
+    };
+    using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+    static constexpr uint32_t salts[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                          0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+    static constexpr size_t elements_per_block = 32;
+    std::vector<Block, BlockAlloc> blocks;
+
+    static uint64_t mix(size_t hash) {
+        return static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ULL;
+    }
+    size_t block_index(uint64_t mixed) const {
+        return ((mixed >> 32) * blocks.size()) >> 32;
+    }
+public:
+    explicit BlockedBloomFilter(const Alloc& alloc = Alloc()): blocks(alloc) {}
+    bool enabled() const noexcept {
+        return !blocks.empty();
+    }
+    void reset(size_t expected_elements) {
+        blocks.assign(expected_elements / elements_per_block + 1, Block());
+    }
+    void clear() {
+        blocks.clear();
+        blocks.shrink_to_fit();
+    }
+    size_t memory_bytes() const noexcept {
+        return blocks.capacity() * sizeof(Block);
+    }
+    void insert(size_t hash) {
+        uint64_t mixed = mix(hash);
+        Block& block = blocks[block_index(mixed)];
+        uint32_t key = static_cast<uint32_t>(mixed);
+        for (size_t i = 0; i < 8; ++i) {
+            block.words[i] |= uint64_t(1) << ((key * salts[i]) >> 26);
+        }
+    }
+    bool may_contain(size_t hash) const {
+        uint64_t mixed = mix(hash);
+        const Block& block = blocks[block_index(mixed)];
+        uint32_t key = static_cast<uint32_t>(mixed);
+        uint64_t missing = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            missing |= ~block.words[i] & (uint64_t(1) << ((key * salts[i]) >> 26));
+        }
+        return missing == 0;
+    }
+};
+
+// Sampled lookup statistics. Each lookup is sampled with probability
+// 1/period by a thread-local generator, so unsampled lookups touch no shared
+// state. Samples are counted in a Count-Min sketch, which estimates any key's
+// frequency, and in a Space-Saving table of the heaviest keys. Memory is
+// fixed once enabled.
+template<typename Key, typename Equal>
+class AccessSampler {
+public:
+    struct HotKey {
+        Key key;
+        uint64_t count;
+        uint64_t error;
+    };
+private:
+    static constexpr size_t sketch_depth = 4;
+    static constexpr size_t sketch_width_bits = 10;
+    static constexpr uint64_t row_multipliers[sketch_depth] = {0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL,
+                                                                0x165667b19e3779f9ULL, 0xd6e8feb86659fd93ULL};
+    struct Counter {
+        Key key;
+        size_t hash;
+        uint64_t count;
+        uint64_t error;
+    };
+    size_t period;
+    size_t capacity;
+    [[no_unique_address]] Equal equal;
+    uint64_t sample_threshold;
+    mutable std::mutex mutex;
+    std::vector<uint32_t> sketch = std::vector<uint32_t>(sketch_depth << sketch_width_bits, 0);
+    std::vector<Counter> counters;
+    uint64_t samples = 0;
+
+    static size_t cell(size_t hash, size_t row) {
+        return (row << sketch_width_bits)
+               + static_cast<size_t>((static_cast<uint64_t>(hash) * row_multipliers[row]) >> (64 - sketch_width_bits));
+    }
+public:
+    AccessSampler(size_t period, size_t capacity, const Equal& equal)
+            : period(period), capacity(std::max(capacity, static_cast<size_t>(1))), equal(equal), sample_threshold(UINT64_MAX / period) {
+        counters.reserve(this->capacity);
+    }
+    size_t sample_period() const noexcept {
+        return period;
+    }
+    void record(const Key& key, size_t hash) {
+        thread_local uint64_t random_state = 0;
+        if (random_state == 0) {
+            random_state = (reinterpret_cast<uintptr_t>(&random_state) * 0x9e3779b97f4a7c15ULL) | 1;
+        }
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 7;
+        random_state ^= random_state << 17;
+        if (random_state > sample_threshold) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        ++samples;
+        for (size_t row = 0; row < sketch_depth; ++row) {
+            uint32_t& count = sketch[cell(hash, row)];
+            count += count != UINT32_MAX;
+        }
+        auto minimum = counters.begin();
+        for (auto it = counters.begin(); it != counters.end(); ++it) {
+            if (it->hash == hash && equal(it->key, key)) {
+                ++it->count;
+                return;
+            }
+            if (it->count < minimum->count) {
+                minimum = it;
+            }
+        }
+        if (counters.size() < capacity) {
+            counters.push_back(Counter{key, hash, 1, 0});
+            return;
+        }
+        minimum->key = key;
+        minimum->hash = hash;
+        minimum->error = minimum->count;
+        ++minimum->count;
+    }
+    // Counts are scaled back to lookups; a key's true count lies in
+    // [count - error, count] up to sampling noise.
+    std::vector<HotKey> hot_keys(size_t k) const {
+        std::vector<HotKey> result;
+        std::lock_guard<std::mutex> lock(mutex);
+        result.reserve(counters.size());
+        for (const Counter& counter : counters) {
+            result.push_back(HotKey{counter.key, counter.count * period, counter.error * period});
+        }
+        k = std::min(k, result.size());
+        std::partial_sort(result.begin(), result.begin() + k, result.end(),
+                          [](const HotKey& left, const HotKey& right) { return left.count > right.count; });
+        result.resize(k);
+        return result;
+    }
+    uint64_t estimate(size_t hash) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t count = UINT32_MAX;
+        for (size_t row = 0; row < sketch_depth; ++row) {
+            count = std::min(count, sketch[cell(hash, row)]);
+        }
+        return static_cast<uint64_t>(count) * period;
+    }
+    uint64_t sampled_lookups() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return samples * period;
+    }
+    size_t memory_bytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return sizeof(AccessSampler) + sketch.capacity() * sizeof(uint32_t) + counters.capacity() * sizeof(Counter);
+    }
+};
+
+// Bytes held by one UnorderedMap, by component. Node figures are exact for
+// the node layout; allocator headers are not included, and the std::map and
+// std::multiset behind tree indexes are estimated at three links and a color
+// word per tree node.
+struct UnorderedMapMemoryUsage {
+    size_t elements = 0;
+    size_t element_capacity = 0;
+    size_t buckets = 0;
+    size_t used_buckets = 0;
+    size_t bucket_array_bytes = 0;
+    size_t node_bytes = 0;
+    size_t node_value_bytes = 0;
+    size_t node_link_bytes = 0;
+    size_t node_hash_bytes = 0;
+    size_t node_padding_bytes = 0;
+    size_t compacted_free_bytes = 0;
+    size_t slab_table_bytes = 0;
+    size_t bloom_bytes = 0;
+    size_t tree_bytes = 0;
+    size_t sampler_bytes = 0;
+
+    size_t total_bytes() const noexcept {
+        return bucket_array_bytes + node_bytes + compacted_free_bytes + slab_table_bytes
+               + bloom_bytes + tree_bytes + sampler_bytes;
+    }
+};
+
+// Whether nodes store the hash of their key. Arithmetic keys under std::hash
+// rehash for free, so their nodes skip the extra size_t; specialize to override.
+template<typename Key, typename Hash>
+struct UnorderedMapCachesHash
+        : std::bool_constant<!(std::is_arithmetic_v<Key> && std::is_same_v<Hash, std::hash<Key>>)> {};
+
+struct UnorderedMapNoCachedHash {
+    UnorderedMapNoCachedHash(size_t) {}
+};
+
+// List payload shared by the hash containers: the element and, when
+// UnorderedMapCachesHash holds, the hash of its key.
+template<typename Key, typename Value, typename Hash>
+struct UnorderedMapNode {
+    constexpr static bool caches_hash = UnorderedMapCachesHash<Key, Hash>::value;
+    std::pair<Key, Value> element;
+    [[no_unique_address]] std::conditional_t<caches_hash, size_t, UnorderedMapNoCachedHash> hash;
+
+    size_t key_hash(const Hash& hasher) const {
+        if constexpr (caches_hash) {
+            return hash;
+        } else {
+            return hasher(element.first);
+        }
+    }
+    // A cached hash is a 64-bit fingerprint of the key: comparing it first
+    // rejects almost every mismatch in a chain without reading the key itself,
+    // which for long strings would mean a miss on their heap buffer.
+    template<typename Equal>
+    bool has_key(const Key& key, size_t hash_of_key, const Equal& equal) const {
+        if constexpr (caches_hash) {
+            if (hash != hash_of_key) {
+                return false;
+            }
+        }
+        return equal(element.first, key);
+    }
+};
+
+// Iterator of the hash containers over their node list; it exposes each
+// node's element with a const key.
+template<typename Node, typename ItValue>
+// NOLINTNEXTLINE
+class UnorderedMapIterator {
+public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = ItValue;
+    using pointer = value_type*;
+    using reference = value_type&;
+    using iterator_category = std::bidirectional_iterator_tag;
+private:
+    BaseNode* node;
+public:
+    BaseNode* return_base_node() {
+        return node;
+    }
+    UnorderedMapIterator(): node(nullptr) {}
+    explicit UnorderedMapIterator(BaseNode* given_node): node(given_node) {}
+    template<typename ListIterator>
+    requires std::is_same_v<std::remove_const_t<typename ListIterator::value_type>, Node>
+    explicit UnorderedMapIterator(ListIterator given_list_it): node(given_list_it.return_base_node()) {}
+
+    value_type& operator*() const {
+        return *reinterpret_cast<value_type*>(&(static_cast<TemplateNode<Node>*>(node)->value.element));
+    }
+    value_type* operator->() const {
+        return reinterpret_cast<value_type*>(&(static_cast<TemplateNode<Node>*>(node)->value.element));
+    }
+
+    UnorderedMapIterator& operator++() {
+        node = node->next;
+        return *this;
+    }
+
+    UnorderedMapIterator operator++(int) {
+        BaseNode* copy = node;
+        node = node->next;
+        return UnorderedMapIterator(copy);
+    }
+
+    UnorderedMapIterator& operator--() {
+        node = node->previous;
+        return *this;
+    }
+
+    UnorderedMapIterator operator--(int) {
+        BaseNode* copy = node;
+        node = node->previous;
+        return UnorderedMapIterator(copy);
+    }
+
+    operator UnorderedMapIterator<Node, const ItValue>() const {
+        return UnorderedMapIterator<Node, const ItValue>(node);
+    }
+
+    bool operator==(const UnorderedMapIterator& other) const = default;
+};
+
+// Rebuilds the bucket heads of a hash container in place. Nodes not yet placed
+// stay in front; each is spliced to the head of its new chain, or right behind
+// the node placed before it when follows(node, previous) holds.
+template<typename NodeList, typename Buckets, typename BucketOf, typename Follows>
+void relink_buckets(NodeList& list, Buckets& buckets, BucketOf bucket_of, Follows follows) {
+    using ListIt = typename NodeList::iterator;
+    ListIt previous = list.end();
+    for (size_t remaining = list.size(); remaining != 0; --remaining) {
+        ListIt it = list.begin();
+        if (previous != list.end() && follows(*it, *previous)) {
+            list.splice(std::next(previous), list, it);
+        } else {
+            size_t bucket = bucket_of(*it);
+            ListIt position = buckets[bucket] != nullptr ? ListIt(buckets[bucket]) : list.end();
+            list.splice(position, list, it);
+            buckets[bucket] = it.return_base_node();
+        }
+        previous = it;
+    }
+}
 
 template<typename Key
         , typename Value
@@ -557,85 +989,98 @@ template<typename Key
 class UnorderedMap {
 public:
     using NodeType = std::pair<const Key, Value>;
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = NodeType;
 private:
     using LowSecurityNodeType = std::pair<Key, Value>;
-    struct HashedNode {
-        LowSecurityNodeType element;
-        size_t hash;
-    };
+    using HashedNode = UnorderedMapNode<Key, Value, Hash>;
+    constexpr static bool caches_hash = HashedNode::caches_hash;
     using AllocTraits = std::allocator_traits<Alloc>;
     using HashedNodeAlloc = typename AllocTraits::template rebind_alloc<HashedNode>;
-    template<typename ItValue>
-    using ListBaseIt = typename List<HashedNode, HashedNodeAlloc>:: template BaseIterator<ItValue>;
+    using BucketAlloc = typename AllocTraits::template rebind_alloc<BaseNode*>;
+    using Buckets = std::vector<BaseNode*, BucketAlloc>;
     using ListIt = typename List<HashedNode, HashedNodeAlloc>::iterator;
     using ListConstIt = typename List<HashedNode, HashedNodeAlloc>::const_iterator;
 
 
+    // Elements whose bucket lies in [first_bucket, last_bucket). Every chain
+    // is contiguous in the list, so disjoint bucket ranges visit disjoint nodes.
     template<typename ItValue>
-    // NOLINTNEXTLINE
-    class BaseIterator {
-    public:
+    class BaseBucketRange {
         friend UnorderedMap;
-        using difference_type = std::ptrdiff_t;
-        using value_type = ItValue;
-        using pointer = value_type*;
-        using reference = value_type&;
-        using iterator_category = std::bidirectional_iterator_tag;
-    private:
-        BaseNode* node;
+        const UnorderedMap* map;
+        size_t first_bucket;
+        size_t last_bucket;
+        BaseBucketRange(const UnorderedMap* map, size_t first_bucket, size_t last_bucket)
+                : map(map), first_bucket(first_bucket), last_bucket(last_bucket) {}
     public:
-        BaseNode* return_base_node() {
-            return node;
-        }
-        BaseIterator() = default;
-        ~BaseIterator() = default;
-        explicit BaseIterator(BaseNode* given_node): node(given_node) {}
-        explicit BaseIterator(ListBaseIt<HashedNode> given_list_it): node(given_list_it.return_base_node()) {}
-        explicit BaseIterator(ListBaseIt<const HashedNode> given_list_it): node(given_list_it.return_base_node()) {}
-        BaseIterator(const BaseIterator& other): node(other.node) {}
-        BaseIterator& operator=(BaseIterator other) {
-            node = other.node;
-            return *this;
-        }
-        value_type& operator*() const {
-            return *reinterpret_cast<NodeType*>(&(static_cast<TemplateNode<HashedNode>*>(node)->value.element));
-        }
-        value_type* operator->() const {
-            return reinterpret_cast<NodeType*>(&(static_cast<TemplateNode<HashedNode>*>(node)->value.element));
-        }
-
-        BaseIterator& operator++() {
-            node = node->next;
-            return *this;
-        }
-
-        BaseIterator operator++(int) {
-            BaseNode* copy = node;
-            node = node->next;
-            return BaseIterator(copy);
-        }
-
-        BaseIterator& operator--() {
-            node = node->previous;
-            return *this;
-        }
+        // NOLINTNEXTLINE
+        class Iterator {
+            friend BaseBucketRange;
+            const UnorderedMap* map;
+            BaseNode* node;
+            size_t bucket;
+            size_t last_bucket;
+
+            void seek_bucket() {
+                while (bucket < last_bucket && map->buckets[bucket] == nullptr) {
+                    ++bucket;
+                }
+                node = bucket < last_bucket ? map->buckets[bucket] : nullptr;
+            }
+            Iterator(const UnorderedMap* map, size_t bucket, size_t last_bucket)
+                    : map(map), node(nullptr), bucket(bucket), last_bucket(last_bucket) {}
+        public:
+            using difference_type = std::ptrdiff_t;
+            using value_type = ItValue;
+            using pointer = value_type*;
+            using reference = value_type&;
+            using iterator_category = std::forward_iterator_tag;
+
+            Iterator(): map(nullptr), node(nullptr), bucket(0), last_bucket(0) {}
+            value_type& operator*() const {
+                return *UnorderedMapIterator<HashedNode, ItValue>(node);
+            }
+            value_type* operator->() const {
+                return UnorderedMapIterator<HashedNode, ItValue>(node).operator->();
+            }
+            Iterator& operator++() {
+                BaseNode* next = node->next;
+                if (next != map->list.cend().return_base_node()
+                    && map->bucketId(map->node_hash(*ListConstIt(next))) == bucket) {
+                    node = next;
+                } else {
+                    ++bucket;
+                    seek_bucket();
+                }
+                return *this;
+            }
+            Iterator operator++(int) {
+                Iterator copy = *this;
+                ++*this;
+                return copy;
+            }
+            bool operator==(const Iterator& other) const {
+                return node == other.node;
+            }
+        };
 
-        BaseIterator operator--(int) {
-            BaseNode* copy = node;
-            node = node->previous;
-            return BaseIterator(copy);
+        Iterator begin() const {
+            Iterator it(map, first_bucket, last_bucket);
+            it.seek_bucket();
+            return it;
         }
-
-        operator BaseIterator<const ItValue>() const {
-            BaseIterator<const ItValue> copy(node);
-            return copy;
+        Iterator end() const {
+            return Iterator();
         }
-
-        bool operator==(const BaseIterator& other) const = default;
     };
 public:
-    using iterator = BaseIterator<NodeType>;
-    using const_iterator = BaseIterator<const NodeType>;
+    using iterator = UnorderedMapIterator<HashedNode, NodeType>;
+    using const_iterator = UnorderedMapIterator<HashedNode, const NodeType>;
+    using bucket_range = BaseBucketRange<NodeType>;
+    using const_bucket_range = BaseBucketRange<const NodeType>;
+    using hot_key = typename AccessSampler<Key, Equal>::HotKey;
 private:
     [[no_unique_address]] Hash hash;
     [[no_unique_address]] Equal equal;
@@ -643,10 +1088,64 @@ private:
     float max_load_factor_value = 1.0;
     const static size_t default_bucket_count = 5;
     List<HashedNode, HashedNodeAlloc> list;
-    std::vector<BaseNode*> buckets;
+    Buckets buckets;
+    BlockedBloomFilter<Alloc> bloom;
+    size_t bloom_stale_erasures = 0;
+
+    // Chains longer than treeify_threshold_value get a side index ordered by
+    // hash, then by key when keys are ordered, turning their walks into
+    // O(log n) searches. The chain itself stays in the list untouched.
+    struct TreeEntry {
+        size_t hash;
+        BaseNode* node;
+    };
+    struct TreeProbe {
+        size_t hash;
+        const Key* key;
+    };
+    constexpr static bool ordered_keys = std::is_same_v<Equal, std::equal_to<Key>>
+            && requires(const Key& left, const Key& right) { left < right; };
+    struct TreeCompare {
+        using is_transparent = void;
+        static const Key& key_of(const BaseNode* node) {
+            return static_cast<const TemplateNode<HashedNode>*>(node)->value.element.first;
+        }
+        static bool less(size_t left_hash, const Key& left, size_t right_hash, const Key& right) {
+            if (left_hash != right_hash) {
+                return left_hash < right_hash;
+            }
+            if constexpr (ordered_keys) {
+                return left < right;
+            } else {
+                return false;
+            }
+        }
+        bool operator()(const TreeEntry& left, const TreeEntry& right) const {
+            return less(left.hash, key_of(left.node), right.hash, key_of(right.node));
+        }
+        bool operator()(const TreeEntry& left, const TreeProbe& right) const {
+            return less(left.hash, key_of(left.node), right.hash, *right.key);
+        }
+        bool operator()(const TreeProbe& left, const TreeEntry& right) const {
+            return less(left.hash, *left.key, right.hash, key_of(right.node));
+        }
+    };
+    using BucketTree = std::multiset<TreeEntry, TreeCompare>;
+    std::map<size_t, BucketTree> trees;
+    size_t treeify_threshold_value = 0;
+    std::unique_ptr<AccessSampler<Key, Equal>> sampler;
+
     void rehash(size_t new_bucket_count);
     size_t bucketId(size_t given_hash) const;
+    size_t node_hash(const HashedNode& node) const;
+    bool node_has_key(const HashedNode& node, const Key& key, size_t key_hash) const;
     void update_buckets(size_t new_bucket_count);
+    void rebuild_bloom();
+    void note_erased(size_t count);
+    const BucketTree* tree_of(size_t bucket) const;
+    ListConstIt tree_find(const BucketTree& tree, const Key& key, size_t key_hash) const;
+    void treeify(size_t bucket);
+    void rebuild_trees();
 
     template<typename U>
     std::pair<iterator, bool> insert_impl(U&& element);
@@ -659,9 +1158,20 @@ public:
     const_iterator end() const;
     void reserve(size_t count);
     size_t max_size() const noexcept;
+    size_t bucket_count() const noexcept;
     float load_factor() const noexcept;
     float max_load_factor() const noexcept;
     void max_load_factor(float ml);
+    bool bloom_filter() const noexcept;
+    void bloom_filter(bool enable);
+    size_t treeify_threshold() const noexcept;
+    void treeify_threshold(size_t threshold);
+    size_t access_sampling() const noexcept;
+    void access_sampling(size_t period, size_t tracked_keys = 64);
+    std::vector<hot_key> hot_keys(size_t k) const;
+    uint64_t estimated_accesses(const Key& key) const;
+    void export_access_profile(std::ostream& out, size_t k) const;
+    UnorderedMapMemoryUsage memory_usage() const;
     UnorderedMap() = default;
     ~UnorderedMap() {
         while (size() != 0) {
@@ -732,6 +1242,17 @@ public:
     iterator erase(const_iterator first, const_iterator last);
     iterator find(const Key& key);
     const_iterator find(const Key& key) const;
+    bool contains(const Key& key) const;
+    std::vector<bucket_range> bucket_range_split(size_t parts);
+    std::vector<const_bucket_range> bucket_range_split(size_t parts) const;
+    template<typename Function>
+    void parallel_for_each(Function function, size_t num_threads = 0);
+    template<typename Function>
+    void parallel_for_each(Function function, size_t num_threads = 0) const;
+    template<typename Predicate>
+    size_t retain(Predicate predicate);
+    void compact();
+    void clear();
     void swap(UnorderedMap& other);
     Alloc get_allocator() const;
 };
@@ -747,6 +1268,17 @@ size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::bucketId(size_t given_hash)
     return given_hash % buckets.size();
 }
 
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::node_hash(const HashedNode& node) const {
+    return node.key_hash(hash);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool UnorderedMap<Key, Value, Hash, Equal, Alloc>::node_has_key(
+        const HashedNode& node, const Key& key, size_t key_hash) const {
+    return node.has_key(key, key_hash, equal);
+}
+
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
 float UnorderedMap<Key, Value, Hash, Equal, Alloc>::max_load_factor() const noexcept {
     return max_load_factor_value;
@@ -757,18 +1289,153 @@ void UnorderedMap<Key, Value, Hash, Equal, Alloc>::max_load_factor(float ml) {
     max_load_factor_value = ml;
 }
 
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool UnorderedMap<Key, Value, Hash, Equal, Alloc>::bloom_filter() const noexcept {
+    return bloom.enabled();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::bloom_filter(bool enable) {
+    if (enable) {
+        rebuild_bloom();
+    } else {
+        bloom.clear();
+        bloom_stale_erasures = 0;
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::rebuild_bloom() {
+    bloom.reset(std::max(size(), static_cast<size_t>(buckets.size() * max_load_factor())));
+    for (auto it = list.begin(); it != list.end(); ++it) {
+        bloom.insert(node_hash(*it));
+    }
+    bloom_stale_erasures = 0;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::note_erased(size_t count) {
+    if (bloom.enabled() && (bloom_stale_erasures += count) > size()) {
+        rebuild_bloom();
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::treeify_threshold() const noexcept {
+    return treeify_threshold_value;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::treeify_threshold(size_t threshold) {
+    treeify_threshold_value = threshold;
+    rebuild_trees();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::access_sampling() const noexcept {
+    return sampler ? sampler->sample_period() : 0;
+}
+
+// A period of 0 turns sampling off and drops the collected statistics.
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::access_sampling(size_t period, size_t tracked_keys) {
+    if (period == 0) {
+        sampler.reset();
+    } else {
+        sampler = std::make_unique<AccessSampler<Key, Equal>>(period, tracked_keys, equal);
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+std::vector<typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::hot_key>
+UnorderedMap<Key, Value, Hash, Equal, Alloc>::hot_keys(size_t k) const {
+    return sampler ? sampler->hot_keys(k) : std::vector<hot_key>();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+uint64_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::estimated_accesses(const Key& key) const {
+    return sampler ? sampler->estimate(hash(key)) : 0;
+}
+
+// CSV with one row per hot key, preceded by the estimated lookup total.
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::export_access_profile(std::ostream& out, size_t k) const {
+    out << "# sampled_lookups=" << (sampler ? sampler->sampled_lookups() : 0)
+        << " period=" << access_sampling() << "\n";
+    out << "key,estimated_accesses,max_overcount\n";
+    for (const hot_key& entry : hot_keys(k)) {
+        out << entry.key << ',' << entry.count << ',' << entry.error << '\n';
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+const typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::BucketTree*
+UnorderedMap<Key, Value, Hash, Equal, Alloc>::tree_of(size_t bucket) const {
+    if (trees.empty()) {
+        return nullptr;
+    }
+    auto it = trees.find(bucket);
+    return it == trees.end() ? nullptr : &it->second;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ListConstIt
+UnorderedMap<Key, Value, Hash, Equal, Alloc>::tree_find(
+        const BucketTree& tree, const Key& key, size_t key_hash) const {
+    auto [first, last] = tree.equal_range(TreeProbe{key_hash, &key});
+    for (; first != last; ++first) {
+        if (equal(TreeCompare::key_of(first->node), key)) {
+            return ListConstIt(first->node);
+        }
+    }
+    return list.cend();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::treeify(size_t bucket) {
+    BucketTree& tree = trees[bucket];
+    tree.clear();
+    for (ListIt it = ListIt(buckets[bucket]); it != list.end(); ++it) {
+        size_t key_hash = node_hash(*it);
+        if (bucketId(key_hash) != bucket) break;
+        tree.insert(TreeEntry{key_hash, it.return_base_node()});
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::rebuild_trees() {
+    trees.clear();
+    if (treeify_threshold_value == 0) {
+        return;
+    }
+    size_t group = buckets.size();
+    size_t length = 0;
+    for (ListIt it = list.begin();; ++it) {
+        size_t shrinked_hash = it == list.end() ? buckets.size() : bucketId(node_hash(*it));
+        if (shrinked_hash != group) {
+            if (group != buckets.size() && length > treeify_threshold_value) {
+                treeify(group);
+            }
+            group = shrinked_hash;
+            length = 0;
+        }
+        if (it == list.end()) break;
+        ++length;
+    }
+}
+
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
 UnorderedMap<Key, Value, Hash, Equal, Alloc>::UnorderedMap(size_t bucket_count
         , const Hash& hash
         , const Equal& equal
         , const Alloc& alloc)
-        : hash(hash), equal(equal), alloc(alloc), list(alloc), buckets(alloc) {
+        : hash(hash), equal(equal), alloc(alloc), list(alloc), buckets(alloc), bloom(alloc) {
     rehash(bucket_count);
 }
 
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
 UnorderedMap<Key, Value, Hash, Equal, Alloc>::UnorderedMap(const Alloc& alloc)
-        : hash(Hash()), equal(Equal()), alloc(alloc), list(alloc), buckets(alloc) {}
+        : hash(Hash()), equal(Equal()), alloc(alloc), list(alloc), buckets(alloc), bloom(alloc) {}
 
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
 UnorderedMap<Key, Value, Hash, Equal, Alloc>::UnorderedMap(const UnorderedMap& other)
@@ -777,7 +1444,10 @@ UnorderedMap<Key, Value, Hash, Equal, Alloc>::UnorderedMap(const UnorderedMap& o
         , alloc(AllocTraits::select_on_container_copy_construction(other.alloc))
         , max_load_factor_value(other.max_load_factor_value)
         , list(other.list)
-        , buckets(alloc) {
+        , buckets(alloc)
+        , bloom(other.bloom)
+        , bloom_stale_erasures(other.bloom_stale_erasures)
+        , treeify_threshold_value(other.treeify_threshold_value) {
     update_buckets(other.buckets.size());
 }
 
@@ -788,7 +1458,12 @@ UnorderedMap<Key, Value, Hash, Equal, Alloc>::UnorderedMap(UnorderedMap&& other)
         , alloc(std::move(other.alloc))
         , max_load_factor_value(std::move(other.max_load_factor_value))
         , list(std::move(other.list))
-        , buckets(std::move(other.buckets)) {}
+        , buckets(std::move(other.buckets))
+        , bloom(std::move(other.bloom))
+        , bloom_stale_erasures(other.bloom_stale_erasures)
+        , trees(std::move(other.trees))
+        , treeify_threshold_value(other.treeify_threshold_value)
+        , sampler(std::move(other.sampler)) {}
 
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
 UnorderedMap<Key, Value, Hash, Equal, Alloc>::UnorderedMap(std::initializer_list<NodeType> init
@@ -807,6 +1482,35 @@ size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::size() const {
     return list.size();
 }
 
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+UnorderedMapMemoryUsage UnorderedMap<Key, Value, Hash, Equal, Alloc>::memory_usage() const {
+    using Node = TemplateNode<HashedNode>;
+    constexpr size_t tree_node_overhead = 4 * sizeof(void*);
+    UnorderedMapMemoryUsage usage;
+    usage.elements = size();
+    usage.element_capacity = max_size();
+    usage.buckets = buckets.size();
+    usage.used_buckets = static_cast<size_t>(std::count_if(buckets.begin(), buckets.end(),
+                                                           [](const BaseNode* head) { return head != nullptr; }));
+    usage.bucket_array_bytes = buckets.capacity() * sizeof(BaseNode*);
+    usage.node_bytes = size() * sizeof(Node);
+    usage.node_value_bytes = size() * sizeof(NodeType);
+    usage.node_link_bytes = size() * sizeof(BaseNode);
+    usage.node_hash_bytes = caches_hash ? size() * sizeof(size_t) : 0;
+    usage.node_padding_bytes = usage.node_bytes - usage.node_value_bytes - usage.node_link_bytes - usage.node_hash_bytes;
+    for (const auto& slab : list.slabs) {
+        usage.compacted_free_bytes += (slab.capacity - slab.live) * sizeof(Node);
+    }
+    usage.slab_table_bytes = list.slabs.capacity() * sizeof(list.slabs[0]);
+    usage.bloom_bytes = bloom.memory_bytes();
+    for (const auto& [bucket, tree] : trees) {
+        usage.tree_bytes += sizeof(std::pair<const size_t, BucketTree>) + tree_node_overhead
+                + tree.size() * (sizeof(TreeEntry) + tree_node_overhead);
+    }
+    usage.sampler_bytes = sampler ? sampler->memory_bytes() : 0;
+    return usage;
+}
+
 struct UnorderedMapAtKeyNotFoundException : std::out_of_range {
     explicit UnorderedMapAtKeyNotFoundException()
             : std::out_of_range("UnorderedMapAtKeyNotFoundException") {}
@@ -869,18 +1573,33 @@ UnorderedMap<Key, Value, Hash, Equal, Alloc>::insert_impl(U&& element) {
     }
     size_t key_hash = hash(element.first);
     size_t shrinked_hash = bucketId(key_hash);
-    if (buckets[shrinked_hash] != nullptr) {
-        for (ListIt it = ListIt(buckets[shrinked_hash]); it != list.end(); ++it) {
-            if (it->hash != key_hash) break;
-            if (equal(it->element.first, element.first)) return {iterator(it), false};
+    bool may_exist = !bloom.enabled() || bloom.may_contain(key_hash);
+    size_t chain_length = 0;
+    if (const BucketTree* tree = tree_of(shrinked_hash)) {
+        if (may_exist) {
+            ListConstIt found = tree_find(*tree, element.first, key_hash);
+            if (found != list.cend()) return {iterator(found.return_base_node()), false};
+        }
+    } else if (buckets[shrinked_hash] != nullptr && (may_exist || treeify_threshold_value != 0)) {
+        for (ListIt it = ListIt(buckets[shrinked_hash]); it != list.end(); ++it, ++chain_length) {
+            if (bucketId(node_hash(*it)) != shrinked_hash) break;
+            if (may_exist && node_has_key(*it, element.first, key_hash)) return {iterator(it), false};
         }
-        buckets[shrinked_hash] = list.insert(ListIt(buckets[shrinked_hash]),
-                                             HashedNode{std::forward<U>(element), key_hash}).return_base_node();
-    } else {
-        buckets[shrinked_hash] = list.insert(list.end(), HashedNode{std::forward<U>(element), key_hash}).return_base_node();
     }
-    if (load_factor() > max_load_factor()) {
+    if (static_cast<float>(size() + 1) / static_cast<float>(buckets.size()) > max_load_factor()) {
         rehash(2 * buckets.size());
+        shrinked_hash = bucketId(key_hash);
+        chain_length = 0;
+    }
+    ListIt position = buckets[shrinked_hash] != nullptr ? ListIt(buckets[shrinked_hash]) : list.end();
+    buckets[shrinked_hash] = list.insert(position, HashedNode{std::forward<U>(element), key_hash}).return_base_node();
+    if (bloom.enabled()) {
+        bloom.insert(key_hash);
+    }
+    if (!trees.empty() && trees.count(shrinked_hash) != 0) {
+        trees[shrinked_hash].insert(TreeEntry{key_hash, buckets[shrinked_hash]});
+    } else if (treeify_threshold_value != 0 && chain_length + 1 > treeify_threshold_value) {
+        treeify(shrinked_hash);
     }
     return {iterator(ListIt(buckets[shrinked_hash])), true};
 }
@@ -908,19 +1627,114 @@ typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator
 UnorderedMap<Key, Value, Hash, Equal, Alloc>::erase(
         typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::const_iterator pos) {
     auto list_const_it = ListConstIt(pos.return_base_node());
-    size_t key_hash = list_const_it->hash;
+    size_t key_hash = node_hash(*list_const_it);
     size_t shrinked_hash = bucketId(key_hash);
+    if (!trees.empty() && trees.count(shrinked_hash) != 0) {
+        BucketTree& tree = trees[shrinked_hash];
+        auto [first, last] = tree.equal_range(TreeEntry{key_hash, list_const_it.return_base_node()});
+        while (first->node != list_const_it.return_base_node()) {
+            ++first;
+        }
+        tree.erase(first);
+        if (tree.size() < treeify_threshold_value / 2) {
+            trees.erase(shrinked_hash);
+        }
+    }
+    ListConstIt next_it;
     if (buckets[shrinked_hash] == list_const_it.return_base_node()) {
-        auto next_it = list.erase(list_const_it);
-        if (next_it != list.end() && next_it->hash == key_hash) {
+        next_it = list.erase(list_const_it);
+        if (next_it != list.end() && bucketId(node_hash(*next_it)) == shrinked_hash) {
             buckets[shrinked_hash] = next_it.return_base_node();
         } else {
             buckets[shrinked_hash] = nullptr;
         }
-        return iterator(next_it);
     } else {
-        return iterator(list.erase(list_const_it));
+        next_it = list.erase(list_const_it);
     }
+    note_erased(1);
+    return iterator(next_it);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template<typename Predicate>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::retain(Predicate predicate) {
+    size_t previous_size = size();
+    size_t group = buckets.size();
+    bool group_has_head = false;
+    ListIt run_start = list.end();
+    // A pending run never crosses a group and a head is nulled only after its
+    // group's run is gone, so if the predicate throws every node left in the
+    // list is still reachable from its bucket.
+    try {
+        for (ListIt it = list.begin(); it != list.end();) {
+            size_t shrinked_hash = bucketId(node_hash(*it));
+            if (shrinked_hash != group) {
+                if (run_start != list.end()) {
+                    list.erase(run_start, it);
+                    run_start = list.end();
+                }
+                if (group != buckets.size() && !group_has_head) {
+                    buckets[group] = nullptr;
+                }
+                group = shrinked_hash;
+                group_has_head = false;
+            }
+            if (!predicate(*iterator(it))) {
+                if (run_start == list.end()) {
+                    run_start = it;
+                }
+                ++it;
+                continue;
+            }
+            if (run_start != list.end()) {
+                list.erase(run_start, it);
+                run_start = list.end();
+            }
+            if (!group_has_head) {
+                buckets[group] = it.return_base_node();
+                group_has_head = true;
+            }
+            ++it;
+        }
+    } catch(...) {
+        if (!trees.empty()) {
+            rebuild_trees();
+        }
+        note_erased(previous_size - size());
+        throw;
+    }
+    if (run_start != list.end()) {
+        list.erase(run_start, list.end());
+    }
+    if (group != buckets.size() && !group_has_head) {
+        buckets[group] = nullptr;
+    }
+    if (!trees.empty()) {
+        rebuild_trees();
+    }
+    note_erased(previous_size - size());
+    return previous_size - size();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::compact() {
+    list.compact();
+    update_buckets(buckets.size());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::clear() {
+    list.erase(list.begin(), list.end());
+    buckets.assign(buckets.size(), nullptr);
+    trees.clear();
+    if (bloom.enabled()) {
+        rebuild_bloom();
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Predicate>
+size_t erase_if(UnorderedMap<Key, Value, Hash, Equal, Alloc>& map, Predicate predicate) {
+    return map.retain([&predicate](const auto& element) { return !predicate(element); });
 }
 
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
@@ -949,16 +1763,105 @@ UnorderedMap<Key, Value, Hash, Equal, Alloc>::find(const Key& key) const {
         return iterator(list.end());
     }
     size_t key_hash = hash(key);
+    if (sampler) {
+        sampler->record(key, key_hash);
+    }
+    if (bloom.enabled() && !bloom.may_contain(key_hash)) {
+        return const_iterator(list.cend());
+    }
     size_t shrinked_hash = bucketId(key_hash);
+    if (const BucketTree* tree = tree_of(shrinked_hash)) {
+        return const_iterator(tree_find(*tree, key, key_hash));
+    }
     if (buckets[shrinked_hash] != nullptr) {
         for (auto it = ListConstIt(buckets[shrinked_hash]); it != list.end(); ++it) {
-            if (bucketId(it->hash) != shrinked_hash) break;
-            if (equal(it->element.first, key)) return const_iterator(it);
+            if (bucketId(node_hash(*it)) != shrinked_hash) break;
+            if (node_has_key(*it, key, key_hash)) return const_iterator(it);
         }
     }
     return const_iterator(list.cend());
 }
 
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool UnorderedMap<Key, Value, Hash, Equal, Alloc>::contains(const Key& key) const {
+    return find(key) != cend();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+std::vector<typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::const_bucket_range>
+UnorderedMap<Key, Value, Hash, Equal, Alloc>::bucket_range_split(size_t parts) const {
+    std::vector<const_bucket_range> ranges;
+    parts = std::max(parts, static_cast<size_t>(1));
+    ranges.reserve(parts);
+    for (size_t part = 0; part < parts; ++part) {
+        ranges.push_back(const_bucket_range(this, part * buckets.size() / parts,
+                                            (part + 1) * buckets.size() / parts));
+    }
+    return ranges;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+std::vector<typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::bucket_range>
+UnorderedMap<Key, Value, Hash, Equal, Alloc>::bucket_range_split(size_t parts) {
+    std::vector<bucket_range> ranges;
+    for (const auto& range : static_cast<const UnorderedMap&>(*this).bucket_range_split(parts)) {
+        ranges.push_back(bucket_range(this, range.first_bucket, range.last_bucket));
+    }
+    return ranges;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template<typename Function>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::parallel_for_each(Function function, size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    num_threads = std::min(num_threads, std::max(size(), static_cast<size_t>(1)));
+    auto ranges = bucket_range_split(num_threads);
+    std::erase_if(ranges, [](const bucket_range& range) { return range.begin() == range.end(); });
+    if (ranges.empty()) {
+        return;
+    }
+    std::vector<std::exception_ptr> errors(ranges.size());
+    auto run = [&](size_t part) {
+        try {
+            for (auto& element : ranges[part]) {
+                function(element);
+            }
+        } catch (...) {
+            errors[part] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(ranges.size() - 1);
+    try {
+        for (size_t part = 1; part < ranges.size(); ++part) {
+            workers.emplace_back(run, part);
+        }
+    } catch(...) {
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        throw;
+    }
+    run(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template<typename Function>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc>::parallel_for_each(Function function, size_t num_threads) const {
+    const_cast<UnorderedMap&>(*this).parallel_for_each(
+            [&function](const NodeType& element) { function(element); }, num_threads);
+}
+
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
 const Value& UnorderedMap<Key, Value, Hash, Equal, Alloc>::at(const Key& key) const {
     auto it = find(key);
@@ -1004,6 +1907,11 @@ size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::max_size() const noexcept {
     return std::floor(buckets.size() * max_load_factor());
 }
 
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::bucket_count() const noexcept {
+    return buckets.size();
+}
+
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
 float UnorderedMap<Key, Value, Hash, Equal, Alloc>::load_factor() const noexcept {
     return static_cast<float>(size()) / static_cast<float>(buckets.size());
@@ -1011,11 +1919,18 @@ float UnorderedMap<Key, Value, Hash, Equal, Alloc>::load_factor() const noexcept
 
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
 void UnorderedMap<Key, Value, Hash, Equal, Alloc>::rehash(size_t new_bucket_count) {
-    decltype(list) moved_list = std::move(list);
+    if (size() != 0) {
+        new_bucket_count = std::max(new_bucket_count,
+                                    static_cast<size_t>(std::ceil(size() / max_load_factor())));
+    }
     buckets.assign(new_bucket_count, nullptr);
-    for (auto it = moved_list.begin(); it != moved_list.end(); ++it) {
-        insert_impl(std::move(it->element));
+    relink_buckets(list, buckets
+            , [this](const HashedNode& node) { return bucketId(node_hash(node)); }
+            , [](const HashedNode&, const HashedNode&) { return false; });
+    if (bloom.enabled()) {
+        rebuild_bloom();
     }
+    rebuild_trees();
 }
 
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
@@ -1027,6 +1942,11 @@ void UnorderedMap<Key, Value, Hash, Equal, Alloc>::swap(
     std::swap(max_load_factor_value, other.max_load_factor_value);
     std::swap(buckets, other.buckets);
     std::swap(list, other.list);
+    std::swap(bloom, other.bloom);
+    std::swap(bloom_stale_erasures, other.bloom_stale_erasures);
+    std::swap(trees, other.trees);
+    std::swap(treeify_threshold_value, other.treeify_threshold_value);
+    std::swap(sampler, other.sampler);
 }
 
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
@@ -1036,7 +1956,9 @@ UnorderedMap<Key, Value, Hash, Equal, Alloc>::operator=(const UnorderedMap& othe
         return *this;
     }
     auto deprecated_alloc = alloc;
-    std::vector<BaseNode*> buckets_copy = buckets;
+    Buckets buckets_copy = buckets;
+    size_t deprecated_treeify_threshold = treeify_threshold_value;
+    treeify_threshold_value = other.treeify_threshold_value;
     try {
         if (AllocTraits::propagate_on_container_copy_assignment::value == true) {
             alloc = other.alloc;
@@ -1046,11 +1968,14 @@ UnorderedMap<Key, Value, Hash, Equal, Alloc>::operator=(const UnorderedMap& othe
     } catch (...) {
         alloc = deprecated_alloc;
         buckets = buckets_copy;
+        treeify_threshold_value = deprecated_treeify_threshold;
         throw;
     }
     max_load_factor_value = other.max_load_factor_value;
     hash = other.hash;
     equal = other.equal;
+    bloom = other.bloom;
+    bloom_stale_erasures = other.bloom_stale_erasures;
     return *this;
 }
 
@@ -1063,29 +1988,37 @@ UnorderedMap<Key, Value, Hash, Equal, Alloc>::operator=(UnorderedMap&& other) {
     max_load_factor_value = std::move(other.max_load_factor_value);
     hash = std::move(other.hash);
     equal = std::move(other.equal);
-    std::vector<BaseNode*> buckets_copy = buckets;
+    Buckets buckets_copy = buckets;
+    size_t deprecated_treeify_threshold = treeify_threshold_value;
+    treeify_threshold_value = other.treeify_threshold_value;
     try {
         list = std::move(other.list);
         update_buckets(other.buckets.size());
     } catch (...) {
         buckets = buckets_copy;
+        treeify_threshold_value = deprecated_treeify_threshold;
         throw;
     }
+    bloom = std::move(other.bloom);
+    bloom_stale_erasures = other.bloom_stale_erasures;
+    sampler = std::move(other.sampler);
     return *this;
 }
 
 template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
 void UnorderedMap<Key, Value, Hash, Equal, Alloc>::update_buckets(size_t new_bucket_count) {
-    buckets = std::vector<BaseNode*>(new_bucket_count);
+    buckets.assign(new_bucket_count, nullptr);
+    trees.clear();
     if (size() == 0) return;
-    size_t shrinked_hash = bucketId(list.begin()->hash);
+    size_t shrinked_hash = bucketId(node_hash(*list.begin()));
     buckets[shrinked_hash] = list.begin().return_base_node();
     for (auto it = ++list.begin(); it != list.end(); ++it) {
-        size_t new_hash = bucketId(it->hash);
+        size_t new_hash = bucketId(node_hash(*it));
         if (new_hash != shrinked_hash) {
             shrinked_hash = new_hash;
             buckets[shrinked_hash] = it.return_base_node();
         }
     }
+    rebuild_trees();
 }
 
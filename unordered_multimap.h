@@ -0,0 +1,417 @@
+#pragma once
+
+#include "unordered_map.h"
+
+#include <cmath>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Hash multimap on the same layout as UnorderedMap: one list whose bucket
+// chains are contiguous, with buckets[id] at the head of each chain. Inside a
+// chain, elements with equal keys are kept next to each other in insertion
+// order, so equal_range() is one probe plus one hop per value.
+template<typename Key
+        , typename Value
+        , typename Hash = std::hash<Key>
+        , typename Equal = std::equal_to<Key>
+        , typename Alloc = std::allocator<std::pair<const Key, Value>>>
+class UnorderedMultiMap {
+public:
+    using NodeType = std::pair<const Key, Value>;
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = NodeType;
+private:
+    using LowSecurityNodeType = std::pair<Key, Value>;
+    using HashedNode = UnorderedMapNode<Key, Value, Hash>;
+    using AllocTraits = std::allocator_traits<Alloc>;
+    using HashedNodeAlloc = typename AllocTraits::template rebind_alloc<HashedNode>;
+    using BucketAlloc = typename AllocTraits::template rebind_alloc<BaseNode*>;
+    using NodeList = List<HashedNode, HashedNodeAlloc>;
+    using ListIt = typename NodeList::iterator;
+    using ListConstIt = typename NodeList::const_iterator;
+public:
+    using iterator = UnorderedMapIterator<HashedNode, NodeType>;
+    using const_iterator = UnorderedMapIterator<HashedNode, const NodeType>;
+private:
+    [[no_unique_address]] Hash hash;
+    [[no_unique_address]] Equal equal;
+    float max_load_factor_value = 1.0;
+    const static size_t default_bucket_count = 5;
+    NodeList list;
+    std::vector<BaseNode*, BucketAlloc> buckets;
+
+    size_t bucketId(size_t given_hash) const;
+    size_t node_hash(const HashedNode& node) const;
+    bool node_has_key(const HashedNode& node, const Key& key, size_t key_hash) const;
+    bool same_key(const HashedNode& left, const HashedNode& right) const;
+    ListConstIt find_group(const Key& key, size_t key_hash) const;
+    void unlink_bucket_head(size_t bucket, ListConstIt removed_head, ListConstIt next);
+    void rehash(size_t new_bucket_count);
+    template<typename U>
+    iterator insert_impl(U&& element);
+public:
+    explicit UnorderedMultiMap(size_t bucket_count = 0
+            , const Hash& hash = Hash()
+            , const Equal& equal = Equal()
+            , const Alloc& alloc = Alloc());
+    UnorderedMultiMap(std::initializer_list<NodeType> init
+            , size_t bucket_count = 0
+            , const Hash& hash = Hash()
+            , const Equal& equal = Equal()
+            , const Alloc& alloc = Alloc());
+    UnorderedMultiMap(const UnorderedMultiMap& other);
+    UnorderedMultiMap(UnorderedMultiMap&& other) = default;
+    UnorderedMultiMap& operator=(const UnorderedMultiMap& other);
+    UnorderedMultiMap& operator=(UnorderedMultiMap&& other) = default;
+    iterator begin();
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end();
+    const_iterator end() const;
+    const_iterator cend() const;
+    size_t size() const;
+    bool empty() const;
+    size_t bucket_count() const noexcept;
+    float load_factor() const noexcept;
+    float max_load_factor() const noexcept;
+    void max_load_factor(float ml);
+    void reserve(size_t count);
+    iterator insert(const NodeType& element);
+    iterator insert(NodeType&& element);
+    template<typename... Args>
+    iterator emplace(Args&&... args);
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    bool contains(const Key& key) const;
+    size_t count(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key);
+    std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+    iterator erase(const_iterator pos);
+    size_t erase(const Key& key);
+    void clear();
+    void swap(UnorderedMultiMap& other);
+    Alloc get_allocator() const;
+};
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::UnorderedMultiMap(size_t bucket_count
+        , const Hash& hash
+        , const Equal& equal
+        , const Alloc& alloc)
+        : hash(hash), equal(equal), list(alloc), buckets(alloc) {
+    rehash(bucket_count);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::UnorderedMultiMap(std::initializer_list<NodeType> init
+        , size_t bucket_count
+        , const Hash& hash
+        , const Equal& equal
+        , const Alloc& alloc)
+        : UnorderedMultiMap(bucket_count, hash, equal, alloc) {
+    for (const auto& element : init) {
+        insert(element);
+    }
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::UnorderedMultiMap(const UnorderedMultiMap& other)
+        : hash(other.hash)
+        , equal(other.equal)
+        , max_load_factor_value(other.max_load_factor_value)
+        , list(other.list)
+        , buckets(other.buckets.get_allocator()) {
+    rehash(other.buckets.size());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>&
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::operator=(const UnorderedMultiMap& other) {
+    if (this != &other) {
+        UnorderedMultiMap copy(other);
+        swap(copy);
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::bucketId(size_t given_hash) const {
+    return given_hash % buckets.size();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::node_hash(const HashedNode& node) const {
+    return node.key_hash(hash);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::node_has_key(
+        const HashedNode& node, const Key& key, size_t key_hash) const {
+    return node.has_key(key, key_hash, equal);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::same_key(
+        const HashedNode& left, const HashedNode& right) const {
+    return node_has_key(left, right.element.first, node_hash(right));
+}
+
+// First element of the key's group, or end().
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::ListConstIt
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::find_group(const Key& key, size_t key_hash) const {
+    size_t shrinked_hash = bucketId(key_hash);
+    if (buckets[shrinked_hash] != nullptr) {
+        for (auto it = ListConstIt(buckets[shrinked_hash]); it != list.end(); ++it) {
+            if (bucketId(node_hash(*it)) != shrinked_hash) break;
+            if (node_has_key(*it, key, key_hash)) return it;
+        }
+    }
+    return list.cend();
+}
+
+// Called after the head of a bucket was erased; next is what followed it.
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::unlink_bucket_head(
+        size_t bucket, ListConstIt removed_head, ListConstIt next) {
+    if (buckets[bucket] != removed_head.return_base_node()) {
+        return;
+    }
+    if (next != list.end() && bucketId(node_hash(*next)) == bucket) {
+        buckets[bucket] = next.return_base_node();
+    } else {
+        buckets[bucket] = nullptr;
+    }
+}
+
+// An element equal to the one placed just before it goes right after it,
+// keeping groups in insertion order.
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::rehash(size_t new_bucket_count) {
+    if (size() != 0) {
+        new_bucket_count = std::max(new_bucket_count,
+                                    static_cast<size_t>(std::ceil(size() / max_load_factor())));
+    }
+    buckets.assign(new_bucket_count, nullptr);
+    relink_buckets(list, buckets
+            , [this](const HashedNode& node) { return bucketId(node_hash(node)); }
+            , [this](const HashedNode& node, const HashedNode& previous) { return same_key(node, previous); });
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template<typename U>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::insert_impl(U&& element) {
+    if (buckets.empty()) {
+        rehash(default_bucket_count);
+    }
+    if (static_cast<float>(size() + 1) / static_cast<float>(buckets.size()) > max_load_factor()) {
+        rehash(2 * buckets.size());
+    }
+    size_t key_hash = hash(element.first);
+    size_t shrinked_hash = bucketId(key_hash);
+    ListConstIt group = find_group(element.first, key_hash);
+    if (group != list.cend()) {
+        ListIt position = ListIt(group.return_base_node());
+        while (position != list.end() && node_has_key(*position, element.first, key_hash)) {
+            ++position;
+        }
+        return iterator(list.insert(position, HashedNode{std::forward<U>(element), key_hash}).return_base_node());
+    }
+    ListIt position = buckets[shrinked_hash] != nullptr ? ListIt(buckets[shrinked_hash]) : list.end();
+    buckets[shrinked_hash] = list.insert(position, HashedNode{std::forward<U>(element), key_hash}).return_base_node();
+    return iterator(buckets[shrinked_hash]);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::insert(const NodeType& element) {
+    return insert_impl(LowSecurityNodeType(element));
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::insert(NodeType&& element) {
+    return insert_impl(std::move(*reinterpret_cast<LowSecurityNodeType*>(&element)));
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template<typename... Args>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::emplace(Args&&... args) {
+    return insert_impl(LowSecurityNodeType(std::forward<Args>(args)...));
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::const_iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::find(const Key& key) const {
+    if (buckets.empty()) {
+        return cend();
+    }
+    return const_iterator(find_group(key, hash(key)).return_base_node());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::find(const Key& key) {
+    auto it = static_cast<const UnorderedMultiMap&>(*this).find(key);
+    return iterator(it.return_base_node());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::contains(const Key& key) const {
+    return find(key) != cend();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+std::pair<typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::const_iterator,
+          typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::const_iterator>
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::equal_range(const Key& key) const {
+    if (buckets.empty()) {
+        return {cend(), cend()};
+    }
+    size_t key_hash = hash(key);
+    ListConstIt first = find_group(key, key_hash);
+    ListConstIt last = first;
+    while (last != list.cend() && node_has_key(*last, key, key_hash)) {
+        ++last;
+    }
+    return {const_iterator(first.return_base_node()), const_iterator(last.return_base_node())};
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+std::pair<typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::iterator,
+          typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::iterator>
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::equal_range(const Key& key) {
+    auto [first, last] = static_cast<const UnorderedMultiMap&>(*this).equal_range(key);
+    return {iterator(first.return_base_node()), iterator(last.return_base_node())};
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::count(const Key& key) const {
+    auto [first, last] = equal_range(key);
+    size_t result = 0;
+    for (; first != last; ++first) {
+        ++result;
+    }
+    return result;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::erase(const_iterator pos) {
+    auto list_const_it = ListConstIt(pos.return_base_node());
+    size_t shrinked_hash = bucketId(node_hash(*list_const_it));
+    ListConstIt next = list.erase(list_const_it);
+    unlink_bucket_head(shrinked_hash, list_const_it, next);
+    return iterator(next.return_base_node());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::erase(const Key& key) {
+    auto [first, last] = equal_range(key);
+    if (first == last) {
+        return 0;
+    }
+    size_t previous_size = size();
+    size_t shrinked_hash = bucketId(hash(key));
+    ListIt list_first(first.return_base_node());
+    ListIt next = list.erase(list_first, ListIt(last.return_base_node()));
+    unlink_bucket_head(shrinked_hash, list_first, next);
+    return previous_size - size();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::clear() {
+    list.erase(list.begin(), list.end());
+    buckets.assign(buckets.size(), nullptr);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::swap(UnorderedMultiMap& other) {
+    std::swap(hash, other.hash);
+    std::swap(equal, other.equal);
+    std::swap(max_load_factor_value, other.max_load_factor_value);
+    std::swap(list, other.list);
+    std::swap(buckets, other.buckets);
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+Alloc UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::get_allocator() const {
+    return Alloc(list.get_allocator());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::begin() {
+    return iterator(list.begin().return_base_node());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::const_iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::begin() const {
+    return cbegin();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::const_iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::cbegin() const {
+    return const_iterator(list.cbegin().return_base_node());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::end() {
+    return iterator(list.end().return_base_node());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::const_iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::end() const {
+    return cend();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+typename UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::const_iterator
+UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::cend() const {
+    return const_iterator(list.cend().return_base_node());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::size() const {
+    return list.size();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+bool UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::empty() const {
+    return list.size() == 0;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::bucket_count() const noexcept {
+    return buckets.size();
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+float UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::load_factor() const noexcept {
+    return static_cast<float>(size()) / static_cast<float>(buckets.size());
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+float UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::max_load_factor() const noexcept {
+    return max_load_factor_value;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::max_load_factor(float ml) {
+    max_load_factor_value = ml;
+}
+
+template<typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMultiMap<Key, Value, Hash, Equal, Alloc>::reserve(size_t count) {
+    rehash(std::ceil(count / max_load_factor()));
+}
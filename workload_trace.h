@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Binary trace: the 8-byte magic followed by 13-byte little-endian records
+// (op, key, value size). Non-integral keys are recorded by their std::hash.
+// access is operator[]: it inserts a default value only when the key is
+// missing, and its value size is that of the value it returned.
+enum class TraceOp : uint8_t {
+    insert = 0,
+    find = 1,
+    erase = 2,
+    access = 3,
+};
+
+struct TraceRecord {
+    TraceOp op;
+    uint64_t key;
+    uint32_t value_size;
+};
+
+struct TraceFormatException : std::runtime_error {
+    explicit TraceFormatException(const std::string& what)
+            : std::runtime_error("TraceFormatException: " + what) {}
+};
+
+constexpr char trace_magic[8] = {'U', 'M', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr size_t trace_record_bytes = 13;
+
+class TraceWriter {
+    std::ofstream out;
+public:
+    explicit TraceWriter(const std::string& path)
+            : out(path, std::ios::binary | std::ios::trunc) {
+        if (!out) {
+            throw TraceFormatException("cannot open " + path);
+        }
+        out.write(trace_magic, sizeof(trace_magic));
+    }
+    void write(const TraceRecord& record) {
+        char bytes[trace_record_bytes];
+        bytes[0] = static_cast<char>(record.op);
+        for (size_t i = 0; i < 8; ++i) {
+            bytes[1 + i] = static_cast<char>(record.key >> (8 * i));
+        }
+        for (size_t i = 0; i < 4; ++i) {
+            bytes[9 + i] = static_cast<char>(record.value_size >> (8 * i));
+        }
+        out.write(bytes, trace_record_bytes);
+    }
+    void flush() {
+        out.flush();
+    }
+};
+
+class TraceReader {
+    std::ifstream in;
+public:
+    explicit TraceReader(const std::string& path)
+            : in(path, std::ios::binary) {
+        char magic[sizeof(trace_magic)];
+        if (!in || !in.read(magic, sizeof(magic)) || std::memcmp(magic, trace_magic, sizeof(magic)) != 0) {
+            throw TraceFormatException("bad header in " + path);
+        }
+    }
+    bool next(TraceRecord& record) {
+        unsigned char bytes[trace_record_bytes];
+        if (!in.read(reinterpret_cast<char*>(bytes), trace_record_bytes)) {
+            return false;
+        }
+        if (bytes[0] > static_cast<unsigned char>(TraceOp::access)) {
+            throw TraceFormatException("unknown op");
+        }
+        record.op = static_cast<TraceOp>(bytes[0]);
+        record.key = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            record.key |= static_cast<uint64_t>(bytes[1 + i]) << (8 * i);
+        }
+        record.value_size = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            record.value_size |= static_cast<uint32_t>(bytes[9 + i]) << (8 * i);
+        }
+        return true;
+    }
+};
+
+// Capture shim: forwards the traced operations to a production map and
+// appends one record per call to the writer.
+template<typename Map>
+class TracedMap {
+    using Key = typename Map::key_type;
+    using Value = typename Map::mapped_type;
+    Map& map;
+    TraceWriter& writer;
+
+    static uint64_t trace_key(const Key& key) {
+        if constexpr (std::is_integral_v<Key> || std::is_enum_v<Key>) {
+            return static_cast<uint64_t>(key);
+        } else {
+            return std::hash<Key>()(key);
+        }
+    }
+    static uint32_t value_size(const Value& value) {
+        if constexpr (requires { value.size(); }) {
+            return static_cast<uint32_t>(value.size());
+        } else {
+            return sizeof(Value);
+        }
+    }
+public:
+    TracedMap(Map& map, TraceWriter& writer): map(map), writer(writer) {}
+
+    Value& operator[](const Key& key) {
+        Value& value = map[key];
+        writer.write({TraceOp::access, trace_key(key), value_size(value)});
+        return value;
+    }
+    void insert_or_assign(const Key& key, Value value) {
+        writer.write({TraceOp::insert, trace_key(key), value_size(value)});
+        map[key] = std::move(value);
+    }
+    auto find(const Key& key) {
+        writer.write({TraceOp::find, trace_key(key), 0});
+        return map.find(key);
+    }
+    void erase(const Key& key) {
+        writer.write({TraceOp::erase, trace_key(key), 0});
+        auto it = map.find(key);
+        if (it != map.end()) {
+            map.erase(it);
+        }
+    }
+};